@@ -0,0 +1,1525 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// signal_process_stack_bench: repeatedly start the stack, wait until the
+// whole tree reports ready, signal it and time how long it takes to fully
+// exit
+//
+// the stack reports its progress over the pipe handed to it with -t - see
+// timing.c for the record format
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
+#endif /* #ifndef _XOPEN_SOURCE */
+
+#include <dirent.h>     // for opendir(3), readdir(3)
+#include <errno.h>      // for errno itself
+#include <fcntl.h>      // for open(2)
+#include <limits.h>     // for INT_MAX, PATH_MAX
+#include <poll.h>       // for poll(2)
+#include <signal.h>     // for kill(3), sigqueue(3)
+#include <stdint.h>     // for uint64_t
+#include <stdlib.h>     // for qsort(3), strtoul(3)
+#include <stdio.h>      // for fprintf(3), perror(3), printf(3)
+#include <string.h>     // for memmove(3), strcmp(3), strtok(3)
+#include <sys/wait.h>   // for waitpid(2)
+#include <time.h>       // for clock_gettime(3), nanosleep(2)
+#include <unistd.h>     // for execv(2), fork(2), pipe(2), readlink(2)
+
+// the fd the stack writes its timing records to
+#define TIMING_FD 3
+
+// deepest stack we keep per-level figures for
+#define MAX_LEVELS 64U
+
+// distinct latency buckets the stack can report probes in - see rtsig.c
+#define MAX_PROBE_BUCKETS 128U
+
+// gap between realtime-signal probes, and after the last before the fatal
+// signal - standard signals are delivered ahead of realtime ones, so probes
+// still queued then would be lost
+#define PROBE_GAP_NS 100000L
+#define PROBE_SETTLE_NS 20000000L
+
+// the signals a storm can be made of, as the stack counts them - see storm.c
+enum storm_signal {
+	STORM_USR2,
+	STORM_CHLD,
+	N_STORM_SIGNALS
+};
+
+static const int
+storm_signums[N_STORM_SIGNALS] = {
+	[STORM_USR2] = SIGUSR2,
+	[STORM_CHLD] = SIGCHLD,
+};
+
+#define MAX_STORM_MIX 8U
+
+// -P: placements to compare, and stack args each can pass
+#define MAX_PLACEMENTS 8U
+#define MAX_PLACEMENT_ARGS 8U
+
+// per-level figures, each the slowest process at that level's
+enum level_event {
+	EV_SPAWN,   // time spent spawning its children
+	EV_SIGNAL,  // signal sent to caught
+	EV_REAPED,  // ... to the last of its children reaped
+	EV_EXIT,    // ... to on_exit
+	N_LEVEL_EVENTS
+};
+
+struct run {
+	uint64_t ready;     // top of the stack started to the whole tree up
+	uint64_t latency;   // signal sent to root reaped
+	uint64_t levels[N_LEVEL_EVENTS][MAX_LEVELS];
+	unsigned depth;
+	int completed;
+	unsigned long processes;
+	unsigned long exits;    // X records - one per process that got to on_exit
+	unsigned long probes_caught;
+	unsigned long storm_sent[MAX_LEVELS][N_STORM_SIGNALS];
+	unsigned long storm_caught[MAX_LEVELS][N_STORM_SIGNALS];
+	uint64_t storm_ns[MAX_LEVELS];
+	unsigned long wrapper_rss_kb;
+	int heap;           // whether the stack reported a heap - see heap.h
+	unsigned long heap_kb[MAX_LEVELS];
+	uint64_t heap_faults[MAX_LEVELS], heap_ns[MAX_LEVELS];
+	// per level, the slowest process to reap its children: how many, over
+	// how many wakeups and system calls, first to last
+	unsigned long reaped[MAX_LEVELS], reap_wakeups[MAX_LEVELS], reap_syscalls[MAX_LEVELS];
+	uint64_t reap_ns[MAX_LEVELS];
+	// per level, the memory footprint every process reported, summed
+	unsigned long footprints[MAX_LEVELS];
+	uint64_t rss_kb[MAX_LEVELS], pss_kb[MAX_LEVELS], dirty_kb[MAX_LEVELS];
+	pid_t leaf;         // -c: the first leaf to report ready, to kill
+	uint64_t recover;   // ... its parent reaping it to its respawn being up
+};
+
+// -W: how long to let a wrapper settle before signaling it, if set - any
+// init or wrapper, the stack's exec mode included, run as is
+static
+unsigned
+wrapper_settle_ms = 0;
+
+// -c: kill a leaf once the tree is up, and signal only once it has been
+// respawned
+static
+int
+crash_mode = 0;
+
+// -S: the storm to send before the fatal signal, if rate is set
+static
+struct {
+	unsigned rate;          // signals per second, across every target
+	unsigned duration_ms;
+	uint64_t levels;        // bit 0 for level 1, and so on
+	struct {
+		enum storm_signal signal;
+		unsigned weight;
+	} mix[MAX_STORM_MIX];
+	unsigned n_mix;
+} storm = { .duration_ms = 100U, .levels = ~UINT64_C(0) };
+
+// -P: the stack args for each placement, split on spaces - run one after
+// another with the same iterations, and compared at the end
+static
+struct {
+	const char *label;
+	char buf[256];
+	char *args[MAX_PLACEMENT_ARGS];
+	unsigned n_args;
+} placements[MAX_PLACEMENTS];
+
+static
+unsigned
+n_placements = 0;
+
+// the processes targeted by this run's storm, as they report in
+static
+struct {
+	pid_t pid;
+	unsigned level;
+} *storm_targets = NULL;
+
+static
+size_t
+n_storm_targets = 0, storm_targets_size = 0;
+
+// probe latencies from every process of every run, by bucket floor
+static
+struct {
+	uint64_t floor;
+	unsigned long count;
+} probe_buckets[MAX_PROBE_BUCKETS];
+
+static
+unsigned
+n_probe_buckets = 0;
+
+static const struct {
+	const char *name;
+	int signum;
+} signal_names[] = {
+	{ "HUP", SIGHUP },
+	{ "INT", SIGINT },
+	{ "QUIT", SIGQUIT },
+	{ "TERM", SIGTERM },
+	{ "USR1", SIGUSR1 },
+	{ "USR2", SIGUSR2 },
+	{ "CHLD", SIGCHLD },
+	{ "KILL", SIGKILL },
+};
+
+static
+uint64_t
+now_ns (void);
+
+static
+int
+parse_uint (const char *str, unsigned *out);
+
+static
+int
+parse_signal (const char *str);
+
+static
+const char *
+signal_name (int signum);
+
+static
+int
+run_once (
+	char **stack_argv,
+	int signum,
+	int to_group,
+	int verbose,
+	unsigned timeout_ms,
+	int probe_signum,
+	unsigned n_probes,
+	struct run *run
+);
+
+static
+void
+send_probes (pid_t pid, int probe_signum, unsigned n_probes);
+
+static
+unsigned long
+wrapper_rss_kb (pid_t top);
+
+static
+int
+handle_probes (const char *line, struct run *run);
+
+static
+int
+parse_storm_levels (const char *str);
+
+static
+int
+parse_storm_mix (const char *str);
+
+static
+int
+add_storm_target (pid_t pid, unsigned level);
+
+static
+int
+add_placement (const char *str);
+
+static
+void
+send_storm (struct run *run);
+
+static
+void
+report_storm (struct run *runs, unsigned n_runs);
+
+static
+int
+handle_record (
+	const char *line,
+	uint64_t sent,
+	struct run *run
+);
+
+static
+int
+compare_u64 (const void *a, const void *b);
+
+static
+uint64_t
+percentile (uint64_t *sorted, size_t n, unsigned pct);
+
+static
+unsigned
+sorted_latencies (struct run *runs, unsigned n_runs, uint64_t *samples);
+
+// returns how many runs unwound with a process missing - one killed rather
+// than exiting
+static
+unsigned
+report (struct run *runs, unsigned n_runs, int signum, int to_group);
+
+static
+void
+report_placements (uint64_t (*summary)[5]);
+
+static
+void
+report_probes (struct run *runs, unsigned n_runs, unsigned long expected);
+
+static
+void
+report_wrapper (struct run *runs, unsigned n_runs);
+
+static
+void
+report_heap (struct run *runs, unsigned n_runs);
+
+static
+void
+report_reaping (struct run *runs, unsigned n_runs);
+
+static
+void
+report_footprint (struct run *runs, unsigned n_runs);
+
+int
+main (int argc, char **argv)
+{
+	unsigned iterations = 100U;
+	unsigned timeout_ms = 5000U;
+	int signum = SIGINT;
+	int to_group = 1;
+	int verbose = 0;
+	unsigned probe_offset = 0, n_probes = 100U;
+	int probes = 0;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "cd:l:m:n:p:P:q:rs:S:T:vW:")) != -1) {
+		switch (opt) {
+		case 'c':
+			crash_mode = 1;
+			break;
+		case 'd':
+			if (parse_uint(optarg, &storm.duration_ms) == -1) {
+				fprintf(stderr, "%s: invalid storm duration: %s\n", argv[0], optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'l':
+			if (parse_storm_levels(optarg) == -1) {
+				fprintf(stderr, "%s: invalid storm levels: %s\n", argv[0], optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'm':
+			if (parse_storm_mix(optarg) == -1) {
+				fprintf(stderr, "%s: invalid storm mix: %s\n", argv[0], optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'n':
+			if (parse_uint(optarg, &iterations) == -1 || iterations < 1) {
+				fprintf(stderr, "%s: invalid iterations: %s\n", argv[0], optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'p':
+			if (parse_uint(optarg, &n_probes) == -1) {
+				fprintf(stderr, "%s: invalid probes: %s\n", argv[0], optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'P':
+			if (add_placement(optarg) == -1) {
+				fprintf(stderr, "%s: invalid placement: %s\n", argv[0], optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'q':
+			if (
+				parse_uint(optarg, &probe_offset) == -1
+				|| probe_offset > (unsigned) (SIGRTMAX - SIGRTMIN)
+			) {
+				fprintf(stderr, "%s: invalid realtime signal: %s\n", argv[0], optarg);
+				return EXIT_FAILURE;
+			}
+			probes = 1;
+			break;
+		case 'r':
+			to_group = 0;
+			break;
+		case 's':
+			if ((signum = parse_signal(optarg)) == -1) {
+				fprintf(stderr, "%s: invalid signal: %s\n", argv[0], optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'S':
+			if (parse_uint(optarg, &storm.rate) == -1 || storm.rate < 1) {
+				fprintf(stderr, "%s: invalid storm rate: %s\n", argv[0], optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'T':
+			if (parse_uint(optarg, &timeout_ms) == -1 || timeout_ms > INT_MAX) {
+				fprintf(stderr, "%s: invalid timeout: %s\n", argv[0], optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		case 'W':
+			if (parse_uint(optarg, &wrapper_settle_ms) == -1 || wrapper_settle_ms < 1) {
+				fprintf(stderr, "%s: invalid settle time: %s\n", argv[0], optarg);
+				return EXIT_FAILURE;
+			}
+			// as a container runtime would
+			to_group = 0;
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind >= argc) goto usage;
+	if (wrapper_settle_ms && (probes || storm.rate)) {
+		fprintf(stderr, "%s: -W takes neither -q nor -S\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (wrapper_settle_ms && crash_mode) {
+		fprintf(stderr, "%s: -W and -c are exclusive\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (storm.rate && storm.n_mix == 0) {
+		storm.mix[0].signal = STORM_USR2;
+		storm.mix[0].weight = 1U;
+		storm.n_mix = 1U;
+	}
+
+	// the stack's argv: its path, our timing fd, the probe signal, storm
+	// counting, a restart for the leaf we kill, then whatever we were given
+	// - which can still override it
+	int stack_argc = argc - optind;
+	char **stack_argv = calloc(
+		(size_t) stack_argc + 9U + MAX_PLACEMENT_ARGS,
+		sizeof(*stack_argv)
+	);
+	struct run *runs = calloc(iterations, sizeof(*runs));
+	if (stack_argv == NULL || runs == NULL) {
+		perror("main: calloc");
+		return EXIT_FAILURE;
+	}
+	static char timing_opt[] = "-t", timing_fd_arg[] = "3";
+	stack_argv[0] = argv[optind];
+	stack_argv[1] = timing_opt;
+	stack_argv[2] = timing_fd_arg;
+	// a wrapper may not know -t - it gets its args as they are
+	int n_opts = wrapper_settle_ms ? 1 : 3;
+	static char probe_opt[] = "-q";
+	char probe_arg[16];
+	if (probes) {
+		snprintf(probe_arg, sizeof(probe_arg), "%u", probe_offset);
+		stack_argv[n_opts++] = probe_opt;
+		stack_argv[n_opts++] = probe_arg;
+	}
+	static char storm_opt[] = "-z", storm_arg[] = "count";
+	if (storm.rate) {
+		stack_argv[n_opts++] = storm_opt;
+		stack_argv[n_opts++] = storm_arg;
+	}
+	static char restart_opt[] = "-k", restart_arg[] = "1";
+	if (crash_mode) {
+		stack_argv[n_opts++] = restart_opt;
+		stack_argv[n_opts++] = restart_arg;
+	}
+	int probe_signum = probes ? SIGRTMIN + (int) probe_offset : 0;
+
+	// signal-to-exit p50, p99 and max, and the leaves' signal p50 and p99,
+	// for each placement
+	uint64_t summary[MAX_PLACEMENTS][5];
+	unsigned n_lost = 0;
+	unsigned n_passes = n_placements ? n_placements : 1U;
+	for (unsigned pass = 0; pass < n_passes; pass++) {
+		// each placement goes ahead of whatever we were given
+		int n_args = n_opts;
+		if (n_placements) {
+			for (unsigned i = 0; i < placements[pass].n_args; i++) {
+				stack_argv[n_args++] = placements[pass].args[i];
+			}
+			printf("%splacement: %s\n", pass ? "\n" : "", placements[pass].label);
+		}
+		for (int i = 1; i < stack_argc; i++) {
+			stack_argv[n_args++] = argv[optind + i];
+		}
+		stack_argv[n_args] = NULL;
+
+		memset(runs, 0, iterations * sizeof(*runs));
+		n_probe_buckets = 0;
+		for (unsigned i = 0; i < iterations; i++) {
+			int res = run_once(
+				stack_argv,
+				signum,
+				to_group,
+				verbose,
+				timeout_ms,
+				probe_signum,
+				n_probes,
+				&runs[i]
+			);
+			if (res == -1) return EXIT_FAILURE;
+		}
+		n_lost += report(runs, iterations, signum, to_group);
+		if (wrapper_settle_ms) report_wrapper(runs, iterations);
+		if (probes) {
+			// every process catches every probe, passed down from the top
+			report_probes(runs, iterations, (unsigned long) n_probes * runs[0].processes);
+		}
+		if (storm.rate) report_storm(runs, iterations);
+		if (runs[0].heap) report_heap(runs, iterations);
+		if (runs[0].depth > 1) report_reaping(runs, iterations);
+		report_footprint(runs, iterations);
+
+		if (n_placements) {
+			uint64_t *samples = calloc(iterations, sizeof(*samples));
+			if (samples == NULL) {
+				perror("main: calloc");
+				return EXIT_FAILURE;
+			}
+			unsigned n = sorted_latencies(runs, iterations, samples);
+			summary[pass][0] = percentile(samples, n, 50U);
+			summary[pass][1] = percentile(samples, n, 99U);
+			summary[pass][2] = n ? samples[n - 1] : 0;
+			n = 0;
+			for (unsigned i = 0; i < iterations; i++) {
+				if (runs[i].completed) samples[n++] = runs[i].levels[EV_SIGNAL][0];
+			}
+			qsort(samples, n, sizeof(*samples), compare_u64);
+			summary[pass][3] = percentile(samples, n, 50U);
+			summary[pass][4] = percentile(samples, n, 99U);
+			free(samples);
+		}
+	}
+	if (n_placements > 1) report_placements(summary);
+	return n_lost ? EXIT_FAILURE : EXIT_SUCCESS;
+
+usage:
+	fprintf(
+		stderr,
+		"usage: %s [-c] [-n iterations] [-p probes] [-q rt_offset] [-r] "
+		"[-P placement]... [-s signal] [-S rate [-d duration_ms] [-l levels] "
+		"[-m mix]] [-T timeout_ms] [-v] [-W settle_ms] [--] stack [stack args...]\n"
+		"mix: comma-separated signal:weight pairs of USR2 and CHLD\n"
+		"placement: stack args as one, such as \"-a 0/1\", \"-N -r 50\" or \"\"\n",
+		argv[0]
+	);
+	return EXIT_FAILURE;
+}
+
+static
+uint64_t
+now_ns (void)
+{
+	// same clock the stack stamps its records with
+	struct timespec ts;
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1) return 0;
+	return (uint64_t) ts.tv_sec * UINT64_C(1000000000) + (uint64_t) ts.tv_nsec;
+}
+
+static
+int
+parse_uint (const char *str, unsigned *out)
+{
+	char *end = NULL;
+	errno = 0;
+	unsigned long val = strtoul(str, &end, 10);
+	if (errno || end == str || *end != '\0' || val > UINT_MAX) {
+		return -1;
+	}
+	*out = (unsigned) val;
+	return 0;
+}
+
+static
+int
+parse_signal (const char *str)
+{
+	if (strncmp(str, "SIG", 3) == 0) str += 3;
+	for (size_t i = 0; i < sizeof(signal_names) / sizeof(*signal_names); i++) {
+		if (strcmp(str, signal_names[i].name) == 0) return signal_names[i].signum;
+	}
+	unsigned signum;
+	if (parse_uint(str, &signum) == -1 || signum < 1 || signum > INT_MAX) {
+		return -1;
+	}
+	return (int) signum;
+}
+
+static
+const char *
+signal_name (int signum)
+{
+	for (size_t i = 0; i < sizeof(signal_names) / sizeof(*signal_names); i++) {
+		if (signal_names[i].signum == signum) return signal_names[i].name;
+	}
+	return NULL;
+}
+
+static
+int
+run_once (
+	char **stack_argv,
+	int signum,
+	int to_group,
+	int verbose,
+	unsigned timeout_ms,
+	int probe_signum,
+	unsigned n_probes,
+	struct run *run
+)
+{
+	int pipe_fds[2];
+	if (pipe(pipe_fds) == -1) {
+		perror("run_once: pipe");
+		return -1;
+	}
+
+	pid_t pid = fork();
+	if (pid == -1) {
+		perror("run_once: fork");
+		return -1;
+	}
+	if (pid == 0) {
+		// own process group, so signaling the group only hits the stack
+		setpgid(0, 0);
+		close(pipe_fds[0]);
+		if (pipe_fds[1] != TIMING_FD) {
+			if (dup2(pipe_fds[1], TIMING_FD) == -1) {
+				perror("run_once: dup2");
+				_exit(127);
+			}
+			close(pipe_fds[1]);
+		}
+		if (!verbose) {
+			int null_fd = open("/dev/null", O_WRONLY);
+			if (null_fd != -1) dup2(null_fd, STDERR_FILENO);
+		}
+		execv(stack_argv[0], stack_argv);
+		perror("run_once: execv");
+		_exit(127);
+	}
+	// close the setpgid race between us signaling and the child running
+	setpgid(pid, pid);
+	close(pipe_fds[1]);
+
+	// a wrapper reports nothing - give it time to come up instead
+	if (wrapper_settle_ms) {
+		struct timespec settle = {
+			.tv_sec = wrapper_settle_ms / 1000U,
+			.tv_nsec = (long) (wrapper_settle_ms % 1000U) * 1000000L,
+		};
+		nanosleep(&settle, NULL);
+		run->wrapper_rss_kb = wrapper_rss_kb(pid);
+		run->ready = (uint64_t) wrapper_settle_ms * 1000000U;
+	}
+
+	// read records until every leaf is ready, signal, then read until every
+	// process in the stack has closed its end of the pipe
+	char buf[4096];
+	size_t buf_len = 0;
+	uint64_t sent = 0;
+	int eof = 0, timed_out = 0, crashed = 0;
+	n_storm_targets = 0;
+	while (!eof) {
+		if (crash_mode && !crashed && run->ready) {
+			if (run->leaf == 0 || kill(run->leaf, SIGKILL) == -1) {
+				fprintf(stderr, "run_once: no leaf to kill - is the stack deeper than 1?\n");
+				kill(-pid, SIGKILL);
+				return -1;
+			}
+			crashed = 1;
+		}
+		if (!sent && run->ready && (!crash_mode || run->recover)) {
+			if (probe_signum) send_probes(pid, probe_signum, n_probes);
+			if (storm.rate) send_storm(run);
+			sent = now_ns();
+			if (kill(to_group ? -pid : pid, signum) == -1) {
+				perror("run_once: kill");
+				return -1;
+			}
+		}
+
+		struct pollfd pfd = { .fd = pipe_fds[0], .events = POLLIN };
+		int polled = poll(&pfd, 1, (int) timeout_ms);
+		if (polled == -1) {
+			if (errno == EINTR) continue;
+			perror("run_once: poll");
+			return -1;
+		}
+		if (polled == 0) {
+			timed_out = 1;
+			break;
+		}
+
+		if (buf_len == sizeof(buf)) {
+			fprintf(stderr, "run_once: timing record too long\n");
+			return -1;
+		}
+		ssize_t n_read = read(
+			pipe_fds[0],
+			buf + buf_len,
+			sizeof(buf) - buf_len
+		);
+		if (n_read == -1) {
+			if (errno == EINTR) continue;
+			perror("run_once: read");
+			return -1;
+		}
+		if (n_read == 0) eof = 1;
+		buf_len += (size_t) n_read;
+
+		char *line = buf, *newline;
+		while ((newline = memchr(line, '\n', buf_len - (size_t) (line - buf)))) {
+			*newline = '\0';
+			if (handle_record(line, sent, run) == -1) {
+				fprintf(stderr, "run_once: bad timing record: %s\n", line);
+				return -1;
+			}
+			line = newline + 1;
+		}
+		buf_len -= (size_t) (line - buf);
+		memmove(buf, line, buf_len);
+	}
+	close(pipe_fds[0]);
+
+	if (timed_out) {
+		// a wedged stack is a result, not an error - clean up and move on
+		kill(-pid, SIGKILL);
+	}
+	while (waitpid(pid, NULL, 0) == -1) {
+		if (errno != EINTR) {
+			perror("run_once: waitpid");
+			return -1;
+		}
+	}
+	if (!sent) {
+		fprintf(
+			stderr,
+			"run_once: stack exited before it was %s\n",
+			crashed ? "respawned" : "ready"
+		);
+		return -1;
+	}
+	run->latency = now_ns() - sent;
+	run->completed = !timed_out;
+	return 0;
+}
+
+static
+int
+handle_record (
+	const char *line,
+	uint64_t sent,
+	struct run *run
+)
+{
+	unsigned level, n_children;
+	long long unsigned pid, ts[3];
+	unsigned long leaves, processes;
+
+	switch (line[0]) {
+	case 'B':
+		if (sscanf(line, "B %u %lu %lu", &level, &leaves, &processes) != 3) {
+			return -1;
+		}
+		run->depth = level < MAX_LEVELS ? level : MAX_LEVELS;
+		run->processes = processes;
+		return 0;
+	case 'Q':
+		return handle_probes(line, run);
+	case 'H':
+		if (sscanf(
+			line,
+			"H %u %llu %lu %llu %llu",
+			&level,
+			&pid,
+			&leaves,
+			&ts[0],
+			&ts[1]
+		) != 5) {
+			return -1;
+		}
+		if (level < 1 || level > run->depth) return 0;
+		// the slowest process at each level, as for the rest
+		run->heap = 1;
+		run->heap_kb[level - 1] = leaves;
+		if (ts[0] > run->heap_faults[level - 1]) run->heap_faults[level - 1] = ts[0];
+		if (ts[1] > run->heap_ns[level - 1]) run->heap_ns[level - 1] = ts[1];
+		return 0;
+	case 'F':
+		if (sscanf(
+			line,
+			"F %u %llu %llu %llu %llu",
+			&level,
+			&pid,
+			&ts[0],
+			&ts[1],
+			&ts[2]
+		) != 5) {
+			return -1;
+		}
+		if (level < 1 || level > run->depth) return 0;
+		run->footprints[level - 1]++;
+		run->rss_kb[level - 1] += ts[0];
+		run->pss_kb[level - 1] += ts[1];
+		run->dirty_kb[level - 1] += ts[2];
+		return 0;
+	case 'W':
+		if (sscanf(
+			line,
+			"W %u %llu %lu %llu %llu %llu",
+			&level,
+			&pid,
+			&leaves,
+			&ts[0],
+			&ts[1],
+			&ts[2]
+		) != 6) {
+			return -1;
+		}
+		if (level < 1 || level > run->depth) return 0;
+		if (ts[2] >= run->reap_ns[level - 1]) {
+			run->reaped[level - 1] = leaves;
+			run->reap_wakeups[level - 1] = (unsigned long) ts[0];
+			run->reap_syscalls[level - 1] = (unsigned long) ts[1];
+			run->reap_ns[level - 1] = ts[2];
+		}
+		return 0;
+	case 'K':
+		if (sscanf(line, "K %u %llu %u %llu", &level, &pid, &n_children, &ts[0]) != 4) {
+			return -1;
+		}
+		// 0 would read as not recovered yet
+		run->recover = ts[0] ? ts[0] : 1U;
+		return 0;
+	case 'R':
+		if (sscanf(line, "R %u %llu", &level, &pid) != 2) return -1;
+		if (level == 1 && run->leaf == 0) run->leaf = (pid_t) pid;
+		return add_storm_target((pid_t) pid, level);
+	case 'Z':
+		if (sscanf(
+			line,
+			"Z %u %llu %llu %llu %llu",
+			&level,
+			&pid,
+			&ts[0],
+			&ts[1],
+			&ts[2]
+		) != 5) {
+			return -1;
+		}
+		if (level < 1 || level > run->depth) return 0;
+		run->storm_caught[level - 1][STORM_USR2] += ts[0];
+		run->storm_caught[level - 1][STORM_CHLD] += ts[1];
+		run->storm_ns[level - 1] += ts[2];
+		return 0;
+	case 'T':
+		if (sscanf(line, "T %llu", &ts[0]) != 1) return -1;
+		// 0 would read as not ready yet
+		run->ready = ts[0] ? ts[0] : 1U;
+		return 0;
+	case 'S':
+		if (sscanf(
+			line,
+			"S %u %llu %u %llu",
+			&level,
+			&pid,
+			&n_children,
+			&ts[0]
+		) != 4) {
+			return -1;
+		}
+		if (level < 1 || level > run->depth) return 0;
+		if (ts[0] > run->levels[EV_SPAWN][level - 1]) {
+			run->levels[EV_SPAWN][level - 1] = ts[0];
+		}
+		return add_storm_target((pid_t) pid, level);
+	case 'X':
+		if (sscanf(
+			line,
+			"X %u %llu %llu %llu %llu",
+			&level,
+			&pid,
+			&ts[0],
+			&ts[1],
+			&ts[2]
+		) != 5) {
+			return -1;
+		}
+		run->exits++;
+		if (level < 1 || level > run->depth || !sent) return 0;
+		for (int i = 0; i < 3; i++) {
+			uint64_t *slowest = &run->levels[EV_SIGNAL + i][level - 1];
+			uint64_t elapsed = ts[i] > sent ? ts[i] - sent : 0;
+			if (ts[i] && elapsed > *slowest) *slowest = elapsed;
+		}
+		return 0;
+	default:
+		return -1;
+	}
+}
+
+static
+unsigned long
+wrapper_rss_kb (pid_t top)
+{
+	// the wrapper is every process in the group running the same binary as
+	// the top of it - whatever it runs in turn is not
+	char path[64], top_exe[PATH_MAX], exe[PATH_MAX];
+	snprintf(path, sizeof(path), "/proc/%d/exe", (int) top);
+	ssize_t top_len = readlink(path, top_exe, sizeof(top_exe));
+	DIR *proc = opendir("/proc");
+	if (top_len <= 0 || proc == NULL) {
+		if (proc) closedir(proc);
+		return 0;
+	}
+
+	unsigned long total_kb = 0;
+	struct dirent *entry;
+	while ((entry = readdir(proc)) != NULL) {
+		unsigned pid;
+		if (parse_uint(entry->d_name, &pid) == -1) continue;
+
+		// pgrp is the third field after "(comm)", which may hold anything
+		char line[512];
+		snprintf(path, sizeof(path), "/proc/%u/stat", pid);
+		FILE *file = fopen(path, "r");
+		if (file == NULL) continue;
+		char *read = fgets(line, sizeof(line), file);
+		fclose(file);
+		char *comm_end = read ? strrchr(line, ')') : NULL;
+		int pgrp = 0;
+		if (comm_end == NULL || sscanf(comm_end + 1, " %*c %*d %d", &pgrp) != 1) continue;
+		if (pgrp != (int) top) continue;
+
+		snprintf(path, sizeof(path), "/proc/%u/exe", pid);
+		ssize_t len = readlink(path, exe, sizeof(exe));
+		if (len != top_len || memcmp(exe, top_exe, (size_t) len) != 0) continue;
+
+		snprintf(path, sizeof(path), "/proc/%u/status", pid);
+		if ((file = fopen(path, "r")) == NULL) continue;
+		unsigned long kb;
+		while (fgets(line, sizeof(line), file)) {
+			if (sscanf(line, "VmRSS: %lu kB", &kb) == 1) {
+				total_kb += kb;
+				break;
+			}
+		}
+		fclose(file);
+	}
+	closedir(proc);
+	return total_kb;
+}
+
+static
+void
+send_probes (pid_t pid, int probe_signum, unsigned n_probes)
+{
+	const struct timespec gap = { .tv_sec = 0, .tv_nsec = PROBE_GAP_NS };
+	const struct timespec settle = { .tv_sec = 0, .tv_nsec = PROBE_SETTLE_NS };
+	unsigned n_failed = 0;
+	for (unsigned i = 0; i < n_probes; i++) {
+		// the stack measures latency against the low 32 bits of this
+		union sigval value = { .sival_int = (int) (uint32_t) now_ns() };
+		if (sigqueue(pid, probe_signum, value) == -1) n_failed++;
+		nanosleep(&gap, NULL);
+	}
+	if (n_failed) {
+		fprintf(stderr, "send_probes: %u of %u probes not queued\n", n_failed, n_probes);
+	}
+	nanosleep(&settle, NULL);
+}
+
+static
+int
+handle_probes (const char *line, struct run *run)
+{
+	unsigned level;
+	long long unsigned pid;
+	unsigned long caught, unstamped;
+	int len = 0;
+	if (sscanf(
+		line,
+		"Q %u %llu %lu %lu%n",
+		&level,
+		&pid,
+		&caught,
+		&unstamped,
+		&len
+	) != 4) {
+		return -1;
+	}
+	run->probes_caught += caught;
+
+	// then " floor:count" per bucket
+	const char *pair = line + len;
+	long long unsigned floor;
+	unsigned long count;
+	int used = 0;
+	while (sscanf(pair, " %llu:%lu%n", &floor, &count, &used) == 2) {
+		pair += used;
+		unsigned i;
+		for (i = 0; i < n_probe_buckets; i++) {
+			if (probe_buckets[i].floor == floor) break;
+		}
+		if (i == n_probe_buckets) {
+			if (n_probe_buckets == MAX_PROBE_BUCKETS) return -1;
+			probe_buckets[n_probe_buckets++].floor = floor;
+		}
+		probe_buckets[i].count += count;
+	}
+	return *pair == '\0' ? 0 : -1;
+}
+
+static
+int
+parse_storm_levels (const char *str)
+{
+	storm.levels = 0;
+	char buf[256];
+	if (snprintf(buf, sizeof(buf), "%s", str) >= (int) sizeof(buf)) return -1;
+	for (char *tok = strtok(buf, ","); tok; tok = strtok(NULL, ",")) {
+		unsigned level;
+		if (parse_uint(tok, &level) == -1 || level < 1 || level > MAX_LEVELS) {
+			return -1;
+		}
+		storm.levels |= UINT64_C(1) << (level - 1);
+	}
+	return storm.levels ? 0 : -1;
+}
+
+static
+int
+parse_storm_mix (const char *str)
+{
+	storm.n_mix = 0;
+	char buf[256];
+	if (snprintf(buf, sizeof(buf), "%s", str) >= (int) sizeof(buf)) return -1;
+	for (char *tok = strtok(buf, ","); tok; tok = strtok(NULL, ",")) {
+		if (storm.n_mix == MAX_STORM_MIX) return -1;
+		unsigned weight = 1U;
+		char *colon = strchr(tok, ':');
+		if (colon) {
+			*colon = '\0';
+			if (parse_uint(colon + 1, &weight) == -1 || weight < 1) return -1;
+		}
+		int signum = parse_signal(tok);
+		enum storm_signal signal;
+		for (signal = 0; signal < N_STORM_SIGNALS; signal++) {
+			if (storm_signums[signal] == signum) break;
+		}
+		if (signal == N_STORM_SIGNALS) return -1;
+		storm.mix[storm.n_mix].signal = signal;
+		storm.mix[storm.n_mix].weight = weight;
+		storm.n_mix++;
+	}
+	return storm.n_mix ? 0 : -1;
+}
+
+static
+int
+add_placement (const char *str)
+{
+	if (n_placements == MAX_PLACEMENTS) return -1;
+	unsigned p = n_placements;
+	placements[p].label = *str ? str : "(none)";
+	placements[p].n_args = 0;
+	int len = snprintf(placements[p].buf, sizeof(placements[p].buf), "%s", str);
+	if (len < 0 || (size_t) len >= sizeof(placements[p].buf)) return -1;
+	for (char *tok = strtok(placements[p].buf, " "); tok; tok = strtok(NULL, " ")) {
+		if (placements[p].n_args == MAX_PLACEMENT_ARGS) return -1;
+		placements[p].args[placements[p].n_args++] = tok;
+	}
+	n_placements++;
+	return 0;
+}
+
+static
+int
+add_storm_target (pid_t pid, unsigned level)
+{
+	if (!storm.rate || level < 1 || level > MAX_LEVELS) return 0;
+	if (!(storm.levels & (UINT64_C(1) << (level - 1)))) return 0;
+	if (n_storm_targets == storm_targets_size) {
+		size_t size = storm_targets_size ? storm_targets_size * 2U : 64U;
+		void *targets = realloc(storm_targets, size * sizeof(*storm_targets));
+		if (targets == NULL) {
+			perror("add_storm_target: realloc");
+			return -1;
+		}
+		storm_targets = targets;
+		storm_targets_size = size;
+	}
+	storm_targets[n_storm_targets].pid = pid;
+	storm_targets[n_storm_targets].level = level;
+	n_storm_targets++;
+	return 0;
+}
+
+static
+void
+send_storm (struct run *run)
+{
+	if (n_storm_targets == 0) return;
+
+	// the same sequence every run: targets round-robin, signals in
+	// proportion to their weights, on a fixed schedule
+	unsigned total_weight = 0;
+	for (unsigned i = 0; i < storm.n_mix; i++) total_weight += storm.mix[i].weight;
+	uint64_t n_signals = (uint64_t) storm.rate * storm.duration_ms / 1000U;
+	uint64_t interval = UINT64_C(1000000000) / storm.rate;
+	uint64_t start = now_ns();
+	for (uint64_t k = 0; k < n_signals; k++) {
+		uint64_t due = start + k * interval;
+		struct timespec at = {
+			.tv_sec = (time_t) (due / UINT64_C(1000000000)),
+			.tv_nsec = (long) (due % UINT64_C(1000000000)),
+		};
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &at, NULL) == EINTR) {
+			continue;
+		}
+
+		unsigned pick = (unsigned) (k % total_weight), m = 0;
+		while (pick >= storm.mix[m].weight) pick -= storm.mix[m++].weight;
+		enum storm_signal signal = storm.mix[m].signal;
+		size_t target = (size_t) (k % n_storm_targets);
+		if (kill(storm_targets[target].pid, storm_signums[signal]) == 0) {
+			run->storm_sent[storm_targets[target].level - 1][signal]++;
+		}
+	}
+
+	// let the last of the storm land before the fatal signal stops the count
+	const struct timespec settle = { .tv_sec = 0, .tv_nsec = PROBE_SETTLE_NS };
+	nanosleep(&settle, NULL);
+}
+
+static
+int
+compare_u64 (const void *a, const void *b)
+{
+	uint64_t lhs = *(const uint64_t *) a, rhs = *(const uint64_t *) b;
+	return (lhs > rhs) - (lhs < rhs);
+}
+
+static
+uint64_t
+percentile (uint64_t *sorted, size_t n, unsigned pct)
+{
+	// nearest-rank
+	if (n == 0) return 0;
+	size_t rank = (n * pct + 99U) / 100U;
+	return sorted[rank ? rank - 1 : 0];
+}
+
+static
+unsigned
+sorted_latencies (struct run *runs, unsigned n_runs, uint64_t *samples)
+{
+	// signal-to-exit of every run that unwound, fastest first
+	unsigned n_completed = 0;
+	for (unsigned i = 0; i < n_runs; i++) {
+		if (runs[i].completed) samples[n_completed++] = runs[i].latency;
+	}
+	qsort(samples, n_completed, sizeof(*samples), compare_u64);
+	return n_completed;
+}
+
+static
+unsigned
+report (struct run *runs, unsigned n_runs, int signum, int to_group)
+{
+	uint64_t *samples = calloc(n_runs, sizeof(*samples));
+	if (samples == NULL) {
+		perror("report: calloc");
+		return 0;
+	}
+
+	const char *name = signal_name(signum);
+	unsigned n_completed = sorted_latencies(runs, n_runs, samples);
+
+	const char *target = to_group ? "process group" : "top of the stack";
+	if (name) {
+		printf("%u iterations, SIG%s to the %s\n", n_runs, name, target);
+	}
+	else {
+		printf("%u iterations, signal %d to the %s\n", n_runs, signum, target);
+	}
+	printf("%u unwound, %u timed out\n", n_completed, n_runs - n_completed);
+	// a process that died of the signal instead of unwinding never got to
+	// its X record - a wrapper writes none at all
+	unsigned n_lost = 0;
+	for (unsigned i = 0; i < n_runs; i++) {
+		if (runs[i].completed && runs[i].exits < runs[i].processes) n_lost++;
+	}
+	if (n_lost) printf("%u unwound with a process killed instead\n", n_lost);
+
+	// every run got as far as ready, or we would have bailed out - a
+	// wrapper's is just the time we gave it
+	uint64_t *ready = wrapper_settle_ms ? NULL : calloc(n_runs, sizeof(*ready));
+	if (ready != NULL) {
+		for (unsigned i = 0; i < n_runs; i++) ready[i] = runs[i].ready;
+		qsort(ready, n_runs, sizeof(*ready), compare_u64);
+		printf(
+			"time-to-ready (us):\tp50 %.1f\tp99 %.1f\tmax %.1f\n",
+			percentile(ready, n_runs, 50U) / 1e3,
+			percentile(ready, n_runs, 99U) / 1e3,
+			ready[n_runs - 1] / 1e3
+		);
+		free(ready);
+	}
+	// -c: every run that got to signaling had its leaf respawned
+	uint64_t *recover = crash_mode ? calloc(n_runs, sizeof(*recover)) : NULL;
+	if (recover != NULL) {
+		for (unsigned i = 0; i < n_runs; i++) recover[i] = runs[i].recover;
+		qsort(recover, n_runs, sizeof(*recover), compare_u64);
+		printf(
+			"time-to-recover (us):\tp50 %.1f\tp99 %.1f\tmax %.1f\n",
+			percentile(recover, n_runs, 50U) / 1e3,
+			percentile(recover, n_runs, 99U) / 1e3,
+			recover[n_runs - 1] / 1e3
+		);
+		free(recover);
+	}
+
+	if (n_completed == 0) {
+		free(samples);
+		return n_lost;
+	}
+	printf(
+		"signal-to-exit (us):\tp50 %.1f\tp99 %.1f\tmax %.1f\n",
+		percentile(samples, n_completed, 50U) / 1e3,
+		percentile(samples, n_completed, 99U) / 1e3,
+		samples[n_completed - 1] / 1e3
+	);
+
+	// per level p50s of the slowest process at that level - 0 means no
+	// process at that level saw the event. Wrappers report no levels
+	if (runs[0].depth == 0) {
+		free(samples);
+		return n_lost;
+	}
+	printf(
+		"level\tspawn p50\tsignal p50\tsignal p99\treaped p50\texit p50 "
+		"(us; all but spawn after signal)\n"
+	);
+	unsigned depth = runs[0].depth;
+	for (unsigned level = depth; level >= 1; level--) {
+		double p50[N_LEVEL_EVENTS], signal_p99 = 0;
+		for (int event = 0; event < N_LEVEL_EVENTS; event++) {
+			size_t n = 0;
+			for (unsigned i = 0; i < n_runs; i++) {
+				if (!runs[i].completed) continue;
+				samples[n++] = runs[i].levels[event][level - 1];
+			}
+			qsort(samples, n, sizeof(*samples), compare_u64);
+			p50[event] = percentile(samples, n, 50U) / 1e3;
+			// the tail is where a cold handler shows
+			if (event == EV_SIGNAL) signal_p99 = percentile(samples, n, 99U) / 1e3;
+		}
+		printf(
+			"%5u\t%9.1f\t%10.1f\t%10.1f\t%10.1f\t%8.1f\n",
+			level,
+			p50[EV_SPAWN],
+			p50[EV_SIGNAL],
+			signal_p99,
+			p50[EV_REAPED],
+			p50[EV_EXIT]
+		);
+	}
+	free(samples);
+	return n_lost;
+}
+
+static
+void
+report_heap (struct run *runs, unsigned n_runs)
+{
+	uint64_t *samples = calloc(n_runs, sizeof(*samples));
+	if (samples == NULL) {
+		perror("report_heap: calloc");
+		return;
+	}
+
+	// the top of the stack populates its heap, every level beneath it
+	// copies what it inherited on write - spawn p50 above is the fork side
+	printf("level\theap MiB\tfaults p50\ttouch p50 (us; the top populating, the rest copying)\n");
+	for (unsigned level = runs[0].depth; level >= 1; level--) {
+		uint64_t p50[2];
+		for (int figure = 0; figure < 2; figure++) {
+			for (unsigned i = 0; i < n_runs; i++) {
+				samples[i] = figure ? runs[i].heap_ns[level - 1] : runs[i].heap_faults[level - 1];
+			}
+			qsort(samples, n_runs, sizeof(*samples), compare_u64);
+			p50[figure] = percentile(samples, n_runs, 50U);
+		}
+		printf(
+			"%5u\t%8.1f\t%10llu\t%9.1f\n",
+			level,
+			runs[0].heap_kb[level - 1] / 1024.0,
+			(long long unsigned) p50[0],
+			p50[1] / 1e3
+		);
+	}
+	free(samples);
+}
+
+static
+void
+report_reaping (struct run *runs, unsigned n_runs)
+{
+	uint64_t *samples = calloc(n_runs, sizeof(*samples));
+	if (samples == NULL) {
+		perror("report_reaping: calloc");
+		return;
+	}
+
+	// a stack of one level has no one reaping, and reports nothing
+	int reported = 0;
+	for (unsigned i = 0; i < n_runs; i++) {
+		for (unsigned level = 2; level <= runs[i].depth; level++) {
+			if (runs[i].reaped[level - 1]) reported = 1;
+		}
+	}
+	if (!reported) {
+		free(samples);
+		return;
+	}
+	printf(
+		"level	reaped	wakeups	syscalls/child	reap p50 (us)	"
+		"children/s p50 (first to last reap)\n"
+	);
+	for (unsigned level = runs[0].depth; level > 1; level--) {
+		unsigned n = 0;
+		unsigned long reaped = 0, wakeups = 0, syscalls = 0;
+		for (unsigned i = 0; i < n_runs; i++) {
+			if (!runs[i].completed || !runs[i].reaped[level - 1]) continue;
+			samples[n++] = runs[i].reap_ns[level - 1];
+			reaped += runs[i].reaped[level - 1];
+			wakeups += runs[i].reap_wakeups[level - 1];
+			syscalls += runs[i].reap_syscalls[level - 1];
+		}
+		if (n == 0) continue;
+		qsort(samples, n, sizeof(*samples), compare_u64);
+		uint64_t ns = percentile(samples, n, 50U);
+		double per_run = (double) reaped / n;
+		printf(
+			"%5u	%6.0f	%7.1f	%14.2f	%13.1f	%.0f\n",
+			level,
+			per_run,
+			(double) wakeups / n,
+			reaped ? (double) syscalls / reaped : 0.0,
+			ns / 1e3,
+			ns ? per_run * 1e9 / (double) ns : 0.0
+		);
+	}
+	free(samples);
+}
+
+static
+void
+report_footprint (struct run *runs, unsigned n_runs)
+{
+	unsigned depth = runs[0].depth;
+	unsigned long reported = 0;
+	for (unsigned level = 1; level <= depth; level++) reported += runs[0].footprints[level - 1];
+	if (reported == 0) return;
+
+	uint64_t *samples = calloc(n_runs, sizeof(*samples));
+	if (samples == NULL) {
+		perror("report_footprint: calloc");
+		return;
+	}
+
+	// per process means over every run - PSS is what adds up across the
+	// tree, RSS counts every shared page again in every process
+	printf("level\tprocesses\trss kB\tpss kB\tprivate dirty kB (per process)\n");
+	for (unsigned level = depth; level >= 1; level--) {
+		unsigned long n = 0;
+		uint64_t rss = 0, pss = 0, dirty = 0;
+		for (unsigned i = 0; i < n_runs; i++) {
+			n += runs[i].footprints[level - 1];
+			rss += runs[i].rss_kb[level - 1];
+			pss += runs[i].pss_kb[level - 1];
+			dirty += runs[i].dirty_kb[level - 1];
+		}
+		if (n == 0) continue;
+		printf(
+			"%5u\t%9.1f\t%6.1f\t%6.1f\t%16.1f\n",
+			level,
+			(double) n / n_runs,
+			(double) rss / n,
+			(double) pss / n,
+			(double) dirty / n
+		);
+	}
+	for (unsigned i = 0; i < n_runs; i++) {
+		samples[i] = 0;
+		for (unsigned level = 1; level <= depth; level++) samples[i] += runs[i].pss_kb[level - 1];
+	}
+	qsort(samples, n_runs, sizeof(*samples), compare_u64);
+	printf(
+		"tree pss (kB):\tp50 %llu\tmax %llu\n",
+		(long long unsigned) percentile(samples, n_runs, 50U),
+		(long long unsigned) samples[n_runs - 1]
+	);
+	free(samples);
+}
+
+static
+void
+report_probes (struct run *runs, unsigned n_runs, unsigned long expected)
+{
+	unsigned long caught = 0;
+	for (unsigned i = 0; i < n_runs; i++) caught += runs[i].probes_caught;
+	printf(
+		"probes caught:\t%lu of %lu sent down the stack\n",
+		caught,
+		expected * n_runs
+	);
+	if (caught == 0) return;
+
+	// buckets arrive in no particular order across processes
+	for (unsigned i = 1; i < n_probe_buckets; i++) {
+		for (unsigned j = i; j > 0 && probe_buckets[j - 1].floor > probe_buckets[j].floor; j--) {
+			uint64_t floor = probe_buckets[j].floor;
+			unsigned long count = probe_buckets[j].count;
+			probe_buckets[j] = probe_buckets[j - 1];
+			probe_buckets[j - 1].floor = floor;
+			probe_buckets[j - 1].count = count;
+		}
+	}
+
+	// nearest-rank again, but of bucket floors - within 25%
+	uint64_t p50 = 0, p99 = 0;
+	unsigned long seen = 0;
+	unsigned long rank50 = (caught * 50U + 99U) / 100U;
+	unsigned long rank99 = (caught * 99U + 99U) / 100U;
+	for (unsigned i = 0; i < n_probe_buckets; i++) {
+		seen += probe_buckets[i].count;
+		if (!p50 && seen >= rank50) p50 = probe_buckets[i].floor;
+		if (!p99 && seen >= rank99) p99 = probe_buckets[i].floor;
+	}
+	printf(
+		"send-to-handler (us):\tp50 %.1f\tp99 %.1f\tmax %.1f\n",
+		p50 / 1e3,
+		p99 / 1e3,
+		probe_buckets[n_probe_buckets - 1].floor / 1e3
+	);
+	printf("bucket floor (ns)\tprobes\n");
+	for (unsigned i = 0; i < n_probe_buckets; i++) {
+		printf(
+			"%17llu\t%6lu\n",
+			(long long unsigned) probe_buckets[i].floor,
+			probe_buckets[i].count
+		);
+	}
+}
+
+static
+void
+report_storm (struct run *runs, unsigned n_runs)
+{
+	printf(
+		"storm: %u signals/s for %u ms per iteration\n",
+		storm.rate,
+		storm.duration_ms
+	);
+	// sent but never counted was coalesced with a signal already pending -
+	// or, for SIGCHLD under the event loop, taken by its reaping
+	printf("level\tsignal\t      sent\t    caught\t coalesced\thandler ns/signal\n");
+	unsigned depth = runs[0].depth;
+	for (unsigned level = depth; level >= 1; level--) {
+		unsigned long sent[N_STORM_SIGNALS] = { 0 }, caught[N_STORM_SIGNALS] = { 0 };
+		uint64_t handler_ns = 0;
+		for (unsigned i = 0; i < n_runs; i++) {
+			for (int signal = 0; signal < N_STORM_SIGNALS; signal++) {
+				sent[signal] += runs[i].storm_sent[level - 1][signal];
+				caught[signal] += runs[i].storm_caught[level - 1][signal];
+			}
+			handler_ns += runs[i].storm_ns[level - 1];
+		}
+		unsigned long all_caught = 0;
+		for (int signal = 0; signal < N_STORM_SIGNALS; signal++) {
+			all_caught += caught[signal];
+		}
+		for (int signal = 0; signal < N_STORM_SIGNALS; signal++) {
+			if (!sent[signal] && !caught[signal]) continue;
+			printf(
+				"%5u\tSIG%s\t%10lu\t%10lu\t%10lu\t%17.1f\n",
+				level,
+				signal_name(storm_signums[signal]),
+				sent[signal],
+				caught[signal],
+				sent[signal] > caught[signal] ? sent[signal] - caught[signal] : 0UL,
+				all_caught ? (double) handler_ns / (double) all_caught : 0.0
+			);
+		}
+	}
+}
+
+static
+void
+report_placements (uint64_t (*summary)[5])
+{
+	printf(
+		"\nplacement\tsignal-to-exit p50\tp99\tmax\tleaf signal p50\tp99 (us)\n"
+	);
+	for (unsigned p = 0; p < n_placements; p++) {
+		printf(
+			"%-15s\t%18.1f\t%.1f\t%.1f\t%15.1f\t%.1f\n",
+			placements[p].label,
+			summary[p][0] / 1e3,
+			summary[p][1] / 1e3,
+			summary[p][2] / 1e3,
+			summary[p][3] / 1e3,
+			summary[p][4] / 1e3
+		);
+	}
+}
+
+static
+void
+report_wrapper (struct run *runs, unsigned n_runs)
+{
+	uint64_t *samples = calloc(n_runs, sizeof(*samples));
+	if (samples == NULL) {
+		perror("report_wrapper: calloc");
+		return;
+	}
+	for (unsigned i = 0; i < n_runs; i++) samples[i] = runs[i].wrapper_rss_kb;
+	qsort(samples, n_runs, sizeof(*samples), compare_u64);
+	printf(
+		"wrapper RSS, idle (kB):\tp50 %llu\tmax %llu\n",
+		(long long unsigned) percentile(samples, n_runs, 50U),
+		(long long unsigned) samples[n_runs - 1]
+	);
+	free(samples);
+}
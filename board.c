@@ -0,0 +1,287 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
+#endif /* #ifndef _XOPEN_SOURCE */
+
+#include <errno.h>      // for errno itself
+#include <signal.h>     // for kill(2)
+#include <stdatomic.h>  // for atomic_uint, atomic_ullong
+#include <stdint.h>     // for uint64_t
+#include <stdio.h>      // for printf(3)
+#include <stdlib.h>     // for calloc(3)
+#include <time.h>       // for nanosleep(2)
+#include <unistd.h>     // for getpid(2)
+
+#include "board.h"
+#include "shared.h"
+#include "stack.h"
+#include "timing.h"
+
+#ifndef BOARD_CACHE_LINE
+#define BOARD_CACHE_LINE 64
+#endif /* #ifndef BOARD_CACHE_LINE */
+
+// how many times a reader retries a slot mid-publish before giving up on it
+// - its writer may have been killed there, leaving seq odd for good
+#ifndef BOARD_SNAPSHOT_TRIES
+#define BOARD_SNAPSHOT_TRIES 4096U
+#endif /* #ifndef BOARD_SNAPSHOT_TRIES */
+
+// a slot's fields change only between seq going odd and going even again -
+// a reader that sees the same even seq before and after copying them has a
+// consistent copy. They are relaxed atomics only so that racing the writer
+// is not undefined behaviour
+struct board_slot {
+	_Alignas(BOARD_CACHE_LINE) atomic_uint seq;
+	atomic_uint state;
+	atomic_uint fork_id;
+	atomic_uint last_signal;
+	atomic_ullong pid;
+	atomic_ullong started_ns;   // CLOCK_MONOTONIC, as timing_now()
+	atomic_ullong changed_ns;   // ... of the last change of state
+	atomic_ullong signal_ns;    // ... of the last signal caught
+};
+
+struct board {
+	// written once by the top of the stack
+	_Alignas(BOARD_CACHE_LINE) unsigned long n_slots;
+	// next slot to be claimed, on a line of its own so that claiming one
+	// doesn't disturb readers of the first slot
+	_Alignas(BOARD_CACHE_LINE) atomic_ulong next_slot;
+	struct board_slot slots[];
+};
+
+// one copy of a slot, as read by board_read() - stale if it could not be
+// read consistently
+struct board_entry {
+	int stale;
+	unsigned state, fork_id, last_signal;
+	uint64_t pid, started_ns, changed_ns, signal_ns;
+};
+
+const char *const
+board_state_names[N_BOARD_STATES] = {
+	[BOARD_EMPTY] = "empty",
+	[BOARD_STARTED] = "started",
+	[BOARD_WAITING] = "waiting",
+	[BOARD_AWAITING] = "awaiting signal",
+	[BOARD_CAUGHT] = "caught",
+	[BOARD_EXITING] = "exiting",
+};
+
+static
+struct board *
+board = NULL;
+
+static
+struct board_slot *
+our_slot = NULL;
+
+// a signal caught while our own board_set() was mid-publish, for it to
+// publish once it is done
+static volatile
+sig_atomic_t
+pending_signum = 0;
+
+static
+int
+slot_publish (enum board_state state, int signum);
+
+// returns 0, or -1 if the slot stayed mid-publish - entry holds the last,
+// torn, copy
+static
+int
+slot_snapshot (struct board_slot *slot, struct board_entry *entry);
+
+int
+board_init (unsigned long n_slots, int top_of_stack)
+{
+	if (top_of_stack) {
+		board = shared_create(
+			"board",
+			sizeof(*board) + n_slots * sizeof(*board->slots)
+		);
+		if (board == NULL) return -1;
+		board->n_slots = n_slots;
+		return 0;
+	}
+	// forked children inherit the mapping as it is
+	if (board) return 0;
+
+	size_t size = 0;
+	board = shared_attach("board", &size);
+	return board ? 0 : -1;
+}
+
+void
+board_claim (void)
+{
+	our_slot = NULL;
+	if (board == NULL) return;
+
+	unsigned long slot = atomic_fetch_add_explicit(
+		&board->next_slot,
+		1UL,
+		memory_order_relaxed
+	);
+	// a stack that respawns could outgrow the board - go unseen, rather
+	// than overwrite anyone
+	if (slot >= board->n_slots) return;
+	our_slot = &board->slots[slot];
+
+	uint64_t now = timing_now();
+	atomic_store_explicit(&our_slot->pid, (unsigned long long) getpid(), memory_order_relaxed);
+	atomic_store_explicit(&our_slot->started_ns, now, memory_order_relaxed);
+	slot_publish(BOARD_STARTED, 0);
+}
+
+void
+board_set (enum board_state state)
+{
+	if (our_slot == NULL) return;
+	slot_publish(state, 0);
+
+	// a handler that found us mid-publish left its signal to us
+	int signum = pending_signum;
+	if (signum) {
+		pending_signum = 0;
+		slot_publish(BOARD_CAUGHT, signum);
+	}
+}
+
+void
+board_signal (int signum)
+{
+	if (our_slot == NULL) return;
+	if (slot_publish(BOARD_CAUGHT, signum) == -1) pending_signum = signum;
+}
+
+int
+board_read (pid_t pid, unsigned interval_ms)
+{
+	size_t size = 0;
+	struct board *target = shared_find(pid, "board", &size);
+	if (target == NULL) return -1;
+
+	unsigned long n_slots = target->n_slots;
+	if (size < sizeof(*target) + n_slots * sizeof(*target->slots)) {
+		errno = EINVAL;
+		return -1;
+	}
+	struct board_entry *entries = calloc(n_slots ? n_slots : 1UL, sizeof(*entries));
+	if (entries == NULL) return -1;
+
+	struct timespec interval = {
+		.tv_sec = (time_t) (interval_ms / 1000U),
+		.tv_nsec = (long) (interval_ms % 1000U) * 1000000L,
+	};
+	for (;;) {
+		// the whole snapshot is plain loads - the clock is read via the
+		// vDSO, where there is one
+		uint64_t now = timing_now();
+		for (unsigned long i = 0; i < n_slots; i++) {
+			entries[i].stale = slot_snapshot(&target->slots[i], &entries[i]) == -1;
+		}
+
+		printf("level\t    pid\tstate          \tsignal\t   up ms\tin state ms\tsince signal ms\n");
+		unsigned max_level = 0;
+		for (unsigned long i = 0; i < n_slots; i++) {
+			if (entries[i].fork_id > max_level) max_level = entries[i].fork_id;
+		}
+		for (unsigned level = max_level; level >= 1; level--) {
+			for (unsigned long i = 0; i < n_slots; i++) {
+				const struct board_entry *entry = &entries[i];
+				if (entry->state == BOARD_EMPTY || entry->fork_id != level) continue;
+				const char *state_name = entry->stale
+					? "stale"
+					: entry->state < N_BOARD_STATES ? board_state_names[entry->state] : "?";
+				printf(
+					"%5u\t%7llu\t%-15s\t%6u\t%8.1f\t%11.1f\t%15.1f\n",
+					entry->fork_id,
+					(long long unsigned) entry->pid,
+					state_name,
+					entry->last_signal,
+					(double) (now - entry->started_ns) / 1e6,
+					(double) (now - entry->changed_ns) / 1e6,
+					entry->signal_ns ? (double) (now - entry->signal_ns) / 1e6 : 0.0
+				);
+			}
+		}
+		fflush(stdout);
+
+		if (interval_ms == 0 || (kill(pid, 0) == -1 && errno == ESRCH)) break;
+		nanosleep(&interval, NULL);
+		printf("\n");
+	}
+	free(entries);
+	return 0;
+}
+
+static
+int
+slot_publish (enum board_state state, int signum)
+{
+	// take seq from even to odd - it is only ever odd here if we are a
+	// handler that interrupted our own process mid-publish
+	unsigned seq = atomic_load_explicit(&our_slot->seq, memory_order_relaxed);
+	do {
+		if (seq & 1U) return -1;
+	} while (!atomic_compare_exchange_weak_explicit(
+		&our_slot->seq,
+		&seq,
+		seq + 1U,
+		memory_order_relaxed,
+		memory_order_relaxed
+	));
+	atomic_thread_fence(memory_order_release);
+
+	uint64_t now = timing_now();
+	atomic_store_explicit(&our_slot->state, (unsigned) state, memory_order_relaxed);
+	atomic_store_explicit(&our_slot->fork_id, fork_id, memory_order_relaxed);
+	atomic_store_explicit(&our_slot->changed_ns, now, memory_order_relaxed);
+	if (signum) {
+		atomic_store_explicit(&our_slot->last_signal, (unsigned) signum, memory_order_relaxed);
+		atomic_store_explicit(&our_slot->signal_ns, now, memory_order_relaxed);
+	}
+
+	atomic_store_explicit(&our_slot->seq, seq + 2U, memory_order_release);
+	return 0;
+}
+
+static
+int
+slot_snapshot (struct board_slot *s, struct board_entry *entry)
+{
+	// the mapping is read-only - loads only from here
+	for (unsigned tries = 0; tries < BOARD_SNAPSHOT_TRIES; tries++) {
+		unsigned before = atomic_load_explicit(&s->seq, memory_order_acquire);
+		entry->state = atomic_load_explicit(&s->state, memory_order_relaxed);
+		entry->fork_id = atomic_load_explicit(&s->fork_id, memory_order_relaxed);
+		entry->last_signal = atomic_load_explicit(&s->last_signal, memory_order_relaxed);
+		entry->pid = atomic_load_explicit(&s->pid, memory_order_relaxed);
+		entry->started_ns = atomic_load_explicit(&s->started_ns, memory_order_relaxed);
+		entry->changed_ns = atomic_load_explicit(&s->changed_ns, memory_order_relaxed);
+		entry->signal_ns = atomic_load_explicit(&s->signal_ns, memory_order_relaxed);
+		atomic_thread_fence(memory_order_acquire);
+		if (!(before & 1U) && atomic_load_explicit(&s->seq, memory_order_relaxed) == before) {
+			return 0;
+		}
+	}
+	return -1;
+}
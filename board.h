@@ -0,0 +1,68 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <sys/types.h>  // for pid_t
+
+// the status board: a region shared by the whole stack, with one
+// cache-line-sized slot per process holding what it is doing, published
+// under a seqlock so that a reader can snapshot the board with plain loads
+// and no syscalls
+
+// what a process is doing - BOARD_EMPTY marks a slot nobody has claimed
+enum board_state {
+	BOARD_EMPTY,
+	BOARD_STARTED,
+	BOARD_WAITING,      // on its children
+	BOARD_AWAITING,     // a leaf, on a signal
+	BOARD_CAUGHT,       // a fatal signal
+	BOARD_EXITING,
+	N_BOARD_STATES
+};
+
+extern const char *const
+board_state_names[N_BOARD_STATES];
+
+// -b: create the board with n_slots slots at the top of the stack, or
+// anywhere else find the one an ancestor created before exec'ing us
+// returns 0, or -1 with errno set
+int
+board_init (unsigned long n_slots, int top_of_stack);
+
+// claim a slot for this process as BOARD_STARTED - once at startup, and
+// again right after every fork
+void
+board_claim (void);
+
+// publish our new state
+void
+board_set (enum board_state state);
+
+// publish that we caught signum
+// async-signal-safe
+void
+board_signal (int signum);
+
+// -B: print snapshots of the board held by pid, every interval_ms until pid
+// exits - or just once, with interval_ms 0
+// returns 0, or -1 with errno set
+int
+board_read (pid_t pid, unsigned interval_ms);
+
+#endif /* #ifndef BOARD_H */
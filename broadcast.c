@@ -0,0 +1,76 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// for MAP_ANONYMOUS
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif /* #ifndef _DEFAULT_SOURCE */
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
+#endif /* #ifndef _XOPEN_SOURCE */
+
+#include <errno.h>      // for errno itself
+#include <signal.h>     // for kill(2)
+#include <stdatomic.h>  // for atomic_flag
+#include <sys/mman.h>   // for mmap(2)
+#include <unistd.h>     // for getpgrp(2)
+
+#include "broadcast.h"
+
+// set by the first process to broadcast - lives in memory shared by the
+// whole stack, so the test-and-set is seen by everyone
+static
+atomic_flag *
+broadcast_done = NULL;
+
+static
+pid_t
+broadcast_pgid = 0;
+
+int
+broadcast_init (void)
+{
+	void *mem = mmap(
+		NULL,
+		sizeof(*broadcast_done),
+		PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS,
+		-1,
+		0
+	);
+	if (mem == MAP_FAILED) return -1;
+
+	broadcast_done = mem;
+	atomic_flag_clear(broadcast_done);
+	broadcast_pgid = getpgrp();
+	return 0;
+}
+
+int
+broadcast_signal (int signum)
+{
+	if (broadcast_done == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	// atomic_flag is the one atomic type guaranteed lock-free, so this is
+	// safe from a signal handler - and across processes
+	if (atomic_flag_test_and_set(broadcast_done)) return 0;
+	if (kill(-broadcast_pgid, signum) == -1) return -1;
+	return 1;
+}
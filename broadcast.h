@@ -0,0 +1,37 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+// the process-group broadcast fast path: the first process in the stack to
+// catch a fatal signal sends it on to the whole process group, once, so every
+// level starts unwinding at the same time - whoever the signal was sent to
+
+// set up the flag shared by every process forked after this, recording our
+// process group as the one to broadcast to
+// returns 0, or -1 with errno set
+int
+broadcast_init (void);
+
+// send signum to the process group, unless someone in the stack already has
+// returns 1 if we sent it, 0 if not, -1 with errno set on failure
+// async-signal-safe
+int
+broadcast_signal (int signum);
+
+#endif /* #ifndef BROADCAST_H */
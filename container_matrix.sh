@@ -0,0 +1,193 @@
+#!/bin/sh
+#
+# Copyright 2023 Tony Lechner
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the “Software”), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so.
+#
+# THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+# container_matrix.sh: run the stack under every `docker run` scenario the
+# README walks through - plain, -it, --init, and --init with
+# TINI_KILL_PROCESS_GROUP - for every set of stack flags and stop signal,
+# and print one tab-separated row per permutation: whether the stack
+# unwound or had to be killed, how many levels caught the signal, its exit
+# status and how long it took to exit
+#
+# with -b, compare against a table it printed before, and exit 1 if any
+# permutation unwinds differently, or takes more than -p percent longer
+
+set -u
+
+image=gcc
+depth=3
+timeout_s=5
+tolerance_pct=50
+baseline=
+flag_sets='none,-i,-g'
+signals='INT,TERM'
+scenarios='plain tty init init-pgroup'
+
+usage () {
+	echo "usage: $0 [-b baseline] [-d depth] [-F flag_sets] [-I image] [-p tolerance_pct] [-s signals] [-t timeout_s]" >&2
+	echo "flag_sets: comma-separated stack flags, each with spaces as + - none for none" >&2
+	exit 2
+}
+
+while getopts b:d:F:I:p:s:t: opt; do
+	case "$opt" in
+	b) baseline=$OPTARG ;;
+	d) depth=$OPTARG ;;
+	F) flag_sets=$OPTARG ;;
+	I) image=$OPTARG ;;
+	p) tolerance_pct=$OPTARG ;;
+	s) signals=$OPTARG ;;
+	t) timeout_s=$OPTARG ;;
+	*) usage ;;
+	esac
+done
+
+command -v docker >/dev/null 2>&1 || { echo "$0: docker not found" >&2; exit 2; }
+command -v script >/dev/null 2>&1 || { echo "$0: script(1) not found, needed for -it" >&2; exit 2; }
+
+# built in the image, as the README does, so it links against the image's
+# libc - kept apart from the host's build
+workdir=$(mktemp -d)
+trap 'rm -rf "$workdir"' EXIT
+bin=_matrix/signal_process_stack_example
+mkdir -p _matrix
+docker run --rm -v "$PWD:/app" --user "$(id -u):$(id -g)" --workdir /app "$image" \
+	make BIN="$bin" "$bin" >/dev/null || exit 2
+
+# quote $1 for sh -c, as script(1) runs its command
+shquote () {
+	printf "'%s'" "$(printf '%s' "$1" | sed "s/'/'\\\\''/g")"
+}
+
+now_ms () {
+	# GNU date - POSIX has no sub-second format
+	echo $(( $(date +%s%N) / 1000000 ))
+}
+
+# wait for the whole tree to come up - the leaves log when they do
+await_ready () {
+	deadline=$(( $(now_ms) + timeout_s * 1000 ))
+	while [ "$(now_ms)" -lt "$deadline" ]; do
+		if docker logs "$1" 2>&1 | grep -q 'last child awaiting signal'; then
+			return 0
+		fi
+		sleep 0.05
+	done
+	return 1
+}
+
+# one permutation: prints its row
+run_cell () {
+	scenario=$1 flags=$2 signal=$3
+	name="signal_stack_matrix_$$_$cell"
+	stack_flags=
+	[ "$flags" = none ] || stack_flags=$(echo "$flags" | tr + ' ')
+	# what every scenario runs with, one word apiece, so that a $PWD with
+	# spaces in it stays one
+	set -- --name "$name" -v "$PWD:/app" --user "$(id -u):$(id -g)" --workdir /app
+	tty_fd=
+
+	case "$scenario" in
+	plain) docker run -d "$@" "$image" "./$bin" -d "$depth" $stack_flags >/dev/null ;;
+	init) docker run -d --init "$@" "$image" "./$bin" -d "$depth" $stack_flags >/dev/null ;;
+	init-pgroup)
+		docker run -d --init -e TINI_KILL_PROCESS_GROUP=1 "$@" "$image" \
+			"./$bin" -d "$depth" $stack_flags >/dev/null
+		;;
+	tty)
+		# -it needs a terminal on our side - script(1) gives it a pty, fed
+		# from a fifo we can type ^C into
+		fifo="$workdir/$name"
+		mkfifo "$fifo"
+		script -qfc "docker run -it --name $name -v $(shquote "$PWD:/app") --user $(id -u):$(id -g) --workdir /app $(shquote "$image") ./$bin -d $depth $stack_flags" /dev/null \
+			<"$fifo" >/dev/null 2>&1 &
+		exec 3>"$fifo"
+		tty_fd=3
+		;;
+	esac
+
+	if ! await_ready "$name"; then
+		printf '%s\t%s\t%s\tnot-ready\t-\t-\t-\n' "$scenario" "$flags" "$signal"
+		docker rm -f "$name" >/dev/null 2>&1
+		[ -z "$tty_fd" ] || exec 3>&-
+		return
+	fi
+
+	# a terminal signals the whole foreground process group - everything
+	# else reaches pid 1 alone
+	start=$(now_ms)
+	if [ -n "$tty_fd" ] && [ "$signal" = INT ]; then
+		printf '\003' >&3
+	else
+		docker kill -s "$signal" "$name" >/dev/null
+	fi
+
+	result=unwound
+	if ! status=$(timeout "$timeout_s" docker wait "$name"); then
+		result=killed
+		docker kill -s KILL "$name" >/dev/null 2>&1
+		status=$(docker wait "$name")
+	fi
+	elapsed=$(( $(now_ms) - start ))
+
+	levels=$(docker logs "$name" 2>&1 | sed -n 's/^fork # *\([0-9][0-9]*\) .*caught signal.*/\1/p' | sort -u | wc -l)
+	printf '%s\t%s\t%s\t%s\t%s/%s\t%s\t%s\n' \
+		"$scenario" "$flags" "$signal" "$result" "$((levels))" "$depth" "$status" "$elapsed"
+
+	[ -z "$tty_fd" ] || exec 3>&-
+	docker rm -f "$name" >/dev/null 2>&1
+}
+
+# compare a row against the baseline's for the same permutation
+check_row () {
+	echo "$1" | {
+		IFS='	' read -r scenario flags signal result levels status elapsed
+		expected=$(awk -F '\t' -v s="$scenario" -v f="$flags" -v g="$signal" \
+			'$1 == s && $2 == f && $3 == g' "$baseline")
+		[ -n "$expected" ] || exit 0
+		echo "$expected" | {
+			IFS='	' read -r _ _ _ base_result base_levels base_status base_elapsed
+			if [ "$result" != "$base_result" ] || [ "$levels" != "$base_levels" ] || [ "$status" != "$base_status" ]; then
+				echo "regression: $scenario $flags $signal: $result $levels $status, was $base_result $base_levels $base_status" >&2
+				exit 1
+			fi
+			case "$base_elapsed" in
+			*[!0-9]*|'') exit 0 ;;
+			esac
+			if [ "$elapsed" -gt $(( base_elapsed * (100 + tolerance_pct) / 100 )) ]; then
+				echo "regression: $scenario $flags $signal: ${elapsed}ms, was ${base_elapsed}ms" >&2
+				exit 1
+			fi
+		}
+	}
+}
+
+cell=0
+failed=0
+printf 'scenario\tflags\tsignal\tresult\tlevels_caught\tstatus\tms\n'
+for scenario in $scenarios; do
+	for flags in $(echo "$flag_sets" | tr , ' '); do
+		for signal in $(echo "$signals" | tr , ' '); do
+			row=$(run_cell "$scenario" "$flags" "$signal")
+			cell=$((cell + 1))
+			echo "$row"
+			if [ -n "$baseline" ] && ! check_row "$row"; then
+				failed=1
+			fi
+		done
+	done
+done
+exit "$failed"
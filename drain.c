@@ -0,0 +1,241 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
+#endif /* #ifndef _XOPEN_SOURCE */
+
+#include <errno.h>      // for errno itself
+#include <signal.h>     // for kill(2), sigaction(2)
+#include <stdatomic.h>  // for atomic_flag
+#include <stdint.h>     // for uint64_t
+#include <time.h>       // for timer_create(2), timer_settime(2)
+
+#include "drain.h"
+#include "log.h"
+#include "stack.h"
+#include "timing.h"
+
+// what we escalate to, one step per expiry of the deadline
+static const int
+escalation_signals[] = { SIGTERM, SIGKILL };
+
+#define N_ESCALATIONS (sizeof(escalation_signals) / sizeof(*escalation_signals))
+
+static const char *const
+escalation_messages[N_ESCALATIONS] = {
+	"drain deadline passed, sending SIGTERM",
+	"drain deadline passed, sending SIGKILL",
+};
+
+static
+pid_t *
+drain_children = NULL;
+
+static
+unsigned
+drain_n_children = 0;
+
+static
+struct itimerspec
+drain_deadline;
+
+// the same deadline, for a caller timing it
+static
+uint64_t
+first_ns = 0, interval_ns = 0;
+
+// set once drain_init() has run, with or without a timer
+static
+int
+drain_enabled = 0;
+
+static
+timer_t
+drain_timer;
+
+// set once the timer exists, so drain_start() knows whether it can arm it
+static volatile
+sig_atomic_t
+drain_timer_ready = 0;
+
+// whoever gets here first - drain_start() or drain_init() - arms the timer
+static
+atomic_flag
+drain_armed = ATOMIC_FLAG_INIT;
+
+// written from the handlers, read back in normal context by drain_report()
+static volatile
+uint64_t
+drain_started = 0;
+
+static volatile
+uint64_t
+escalated_at[N_ESCALATIONS];
+
+static volatile
+unsigned
+escalated_to[N_ESCALATIONS];
+
+static volatile
+sig_atomic_t
+n_escalations = 0;
+
+static
+void
+drain_arm (void);
+
+static
+void
+on_deadline (int signum);
+
+static
+void
+escalate (void);
+
+int
+drain_init (unsigned deadline_ms, pid_t *children, unsigned n_children, int timer)
+{
+	drain_children = children;
+	drain_n_children = n_children;
+	drain_enabled = 1;
+	// every level beneath us gets to escalate twice before we escalate once,
+	// so the parent of a wedged process kills it - not some ancestor, which
+	// would orphan whatever lies between. The second step follows the first
+	// by one deadline
+	unsigned long long first_ms = (2ULL * fork_id - 3ULL) * deadline_ms;
+	drain_deadline.it_value.tv_sec = (time_t) (first_ms / 1000U);
+	drain_deadline.it_value.tv_nsec = (long) (first_ms % 1000U) * 1000000L;
+	drain_deadline.it_interval.tv_sec = (time_t) (deadline_ms / 1000U);
+	drain_deadline.it_interval.tv_nsec = (long) (deadline_ms % 1000U) * 1000000L;
+	first_ns = first_ms * UINT64_C(1000000);
+	interval_ns = deadline_ms * UINT64_C(1000000);
+	if (!timer) return 0;
+
+	// restart whatever wait the deadline interrupts - escalation is all done
+	// from the handler
+	struct sigaction action = { .sa_handler = on_deadline, .sa_flags = SA_RESTART };
+	sigemptyset(&action.sa_mask);
+	if (sigaction(SIGALRM, &action, NULL) == -1) return -1;
+
+	// timers are not inherited across fork(2), so every level makes its own
+	struct sigevent event = {
+		.sigev_notify = SIGEV_SIGNAL,
+		.sigev_signo = SIGALRM,
+	};
+	if (timer_create(CLOCK_MONOTONIC, &event, &drain_timer) == -1) return -1;
+	drain_timer_ready = 1;
+
+	// the signal may have beaten us here
+	if (drain_started) drain_arm();
+	return 0;
+}
+
+void
+drain_reset (void)
+{
+	drain_timer_ready = 0;
+	drain_enabled = 0;
+	drain_children = NULL;
+	drain_n_children = 0;
+	drain_started = 0;
+	n_escalations = 0;
+	atomic_flag_clear(&drain_armed);
+}
+
+void
+drain_start (void)
+{
+	if (drain_started) return;
+	drain_started = timing_now();
+	if (drain_timer_ready) drain_arm();
+}
+
+uint64_t
+drain_due (void)
+{
+	if (!drain_started || n_escalations >= (sig_atomic_t) N_ESCALATIONS) return 0;
+	return drain_started + first_ns + (uint64_t) n_escalations * interval_ns;
+}
+
+void
+drain_expire (void)
+{
+	escalate();
+}
+
+void
+drain_report (void)
+{
+	if (!drain_enabled) return;
+	if (drain_timer_ready) {
+		struct itimerspec disarm = { 0 };
+		timer_settime(drain_timer, 0, &disarm, NULL);
+	}
+
+	for (sig_atomic_t i = 0; i < n_escalations; i++) {
+		logmsg(
+			"drain deadline passed: sent signal %d to %u children after %.3f ms",
+			escalation_signals[i],
+			escalated_to[i],
+			(double) (escalated_at[i] - drain_started) / 1e6
+		);
+	}
+}
+
+static
+void
+drain_arm (void)
+{
+	if (atomic_flag_test_and_set(&drain_armed)) return;
+	timer_settime(drain_timer, 0, &drain_deadline, NULL);
+}
+
+static
+void
+on_deadline (int signum)
+{
+	// only async-signal-safe calls from here, as in on_signal()
+	(void) signum;
+	int saved_errno = errno;
+	escalate();
+	errno = saved_errno;
+}
+
+static
+void
+escalate (void)
+{
+	sig_atomic_t step = n_escalations;
+	if (step >= (sig_atomic_t) N_ESCALATIONS) return;
+	unsigned n_signaled = 0;
+	for (unsigned i = 0; i < drain_n_children; i++) {
+		if (drain_children[i] && kill(drain_children[i], escalation_signals[step]) == 0) {
+			n_signaled++;
+		}
+	}
+	escalated_at[step] = timing_now();
+	escalated_to[step] = n_signaled;
+	n_escalations = step + 1;
+	logmsg_async(escalation_messages[step]);
+
+	// nothing left to escalate to
+	if (n_escalations == (sig_atomic_t) N_ESCALATIONS && drain_timer_ready) {
+		struct itimerspec disarm = { 0 };
+		timer_settime(drain_timer, 0, &disarm, NULL);
+	}
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef DRAIN_H
+#define DRAIN_H
+
+#include <stdint.h>     // for uint64_t
+#include <sys/types.h>  // for pid_t
+
+// the graceful-drain deadline: once a level catches its fatal signal, its
+// children have deadline_ms to exit before it escalates to SIGTERM, and as
+// long again before SIGKILL - so a wedged child holds its parent up for a
+// bounded time, rather than forever. Levels further up wait longer, giving
+// the levels beneath them time to escalate first
+
+// watch the n_children pids in children, which are zeroed as they are
+// reaped, and arm the deadline if the drain has already started - on a
+// timer of our own, or, without timer, on whatever the caller waits on,
+// through drain_due() and drain_expire()
+// returns 0, or -1 with errno set
+int
+drain_init (unsigned deadline_ms, pid_t *children, unsigned n_children, int timer);
+
+// forget the drain our parent set up - its children, and its timer, which
+// fork(2) did not copy - before we set up our own, if we do
+void
+drain_reset (void);
+
+// start the clock on the drain, once - every call after the first is ignored
+// async-signal-safe
+void
+drain_start (void);
+
+// when the next escalation is due, in timing_now() nanoseconds - 0 before the
+// drain starts, and once there is nothing left to escalate to
+uint64_t
+drain_due (void);
+
+// escalate now, as our own timer would have once drain_due() passed
+void
+drain_expire (void);
+
+// stop the clock, and log when we escalated, if we did
+void
+drain_report (void);
+
+#endif /* #ifndef DRAIN_H */
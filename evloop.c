@@ -0,0 +1,300 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif /* #ifndef _GNU_SOURCE */
+#endif /* #ifdef __linux__ */
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
+#endif /* #ifndef _XOPEN_SOURCE */
+
+#include <errno.h>      // for errno itself
+#include <signal.h>     // for sigprocmask(2)
+#include <stdint.h>     // for uint64_t, UINT64_MAX
+#include <stdio.h>      // for perror(3)
+#include <stdlib.h>     // for calloc(3)
+#include <sys/wait.h>   // for WNOHANG
+#include <unistd.h>     // for close(2), read(2)
+
+#ifdef __linux__
+#include <sys/epoll.h>      // for epoll_create1(2), epoll_ctl(2), epoll_wait(2)
+#include <sys/signalfd.h>   // for signalfd(2)
+#endif /* #ifdef __linux__ */
+
+#include "evloop.h"
+#include "log.h"
+#include "pidfd.h"
+#include "reap.h"
+#include "stats.h"
+#include "usage.h"
+
+#ifdef __linux__
+
+#define MAX_EVENTS 64
+
+// the signalfd's event data - any other is the slot of the child whose pidfd
+// it is, so that reaping one never searches for it
+#define LOOP_SIG_SLOT UINT64_MAX
+
+// the signals handed to on_sig, set by evloop_block_signals()
+static
+sigset_t
+handled;
+
+// the loop's epoll set, with a signalfd for mask already added
+// returns the epoll fd and stores the signalfd in *sig_fd
+static
+int
+loop_open (const sigset_t *mask, int *sig_fd);
+
+// read every queued signal off sig_fd
+// SIGCHLD reaps whatever children have exited, zeroing them in children and
+// decrementing *remaining
+static
+int
+loop_read_signals (
+	int sig_fd,
+	void (*on_sig)(int),
+	pid_t *children,
+	unsigned n_children,
+	unsigned *remaining
+);
+
+int
+evloop_block_signals (const sigset_t *signals)
+{
+	handled = *signals;
+	sigset_t blocked = *signals;
+	sigaddset(&blocked, SIGCHLD);
+	return sigprocmask(SIG_BLOCK, &blocked, NULL);
+}
+
+int
+evloop_await_signal (void (*on_sig)(int), const volatile sig_atomic_t *done)
+{
+	int sig_fd;
+	int ep_fd = loop_open(&handled, &sig_fd);
+	if (ep_fd == -1) return -1;
+
+	int res = 0;
+	while (res == 0 && !*done) {
+		struct epoll_event event;
+		int n_events = epoll_wait(ep_fd, &event, 1, -1);
+		if (n_events == -1) {
+			// a stop/continue, or a handler for a signal outside our set
+			if (errno == EINTR) continue;
+			perror("evloop_await_signal: epoll_wait");
+			res = -1;
+			break;
+		}
+		res = loop_read_signals(sig_fd, on_sig, NULL, 0, NULL);
+	}
+	close(sig_fd);
+	close(ep_fd);
+	return res;
+}
+
+int
+evloop_reap (pid_t *children, unsigned n_children, void (*on_sig)(int))
+{
+	int *pidfds = calloc(n_children ? n_children : 1U, sizeof(*pidfds));
+	if (pidfds == NULL) {
+		perror("evloop_reap: calloc");
+		return -1;
+	}
+
+	// one pidfd per child, or fall back to reaping on SIGCHLD if the kernel
+	// has none
+	sigset_t mask = handled;
+	int res = -1, sig_fd = -1, ep_fd = -1;
+	unsigned n_pidfds = 0;
+	for (; n_pidfds < n_children; n_pidfds++) {
+		if ((pidfds[n_pidfds] = pidfd_open_child(children[n_pidfds])) == -1) {
+			break;
+		}
+	}
+	if (n_pidfds < n_children) {
+		if (errno != ENOSYS) {
+			perror("evloop_reap: pidfd_open");
+			goto out;
+		}
+		while (n_pidfds > 0) close(pidfds[--n_pidfds]);
+		sigaddset(&mask, SIGCHLD);
+	}
+
+	if ((ep_fd = loop_open(&mask, &sig_fd)) == -1) goto out;
+	for (unsigned i = 0; i < n_pidfds; i++) {
+		struct epoll_event event = { .events = EPOLLIN, .data.u64 = i };
+		if (epoll_ctl(ep_fd, EPOLL_CTL_ADD, pidfds[i], &event) == -1) {
+			perror("evloop_reap: epoll_ctl");
+			goto out;
+		}
+	}
+
+	unsigned remaining = n_children;
+	res = 0;
+	while (remaining > 0 && res == 0) {
+		struct epoll_event events[MAX_EVENTS];
+		uint64_t wait_start = stats_wait_begin();
+		int n_events = epoll_wait(ep_fd, events, MAX_EVENTS, -1);
+		stats_wait_end(wait_start, n_events == -1 && errno == EINTR);
+		reap_syscalls(1);
+		if (n_events == -1) {
+			if (errno == EINTR) continue;
+			perror("evloop_reap: epoll_wait");
+			res = -1;
+			break;
+		}
+		reap_woke();
+		for (int i = 0; i < n_events && res == 0; i++) {
+			uint64_t slot = events[i].data.u64;
+			if (slot == LOOP_SIG_SLOT) {
+				res = loop_read_signals(sig_fd, on_sig, children, n_children, &remaining);
+				continue;
+			}
+			int fd = pidfds[slot];
+			if (pidfd_reap(fd) == -1) {
+				perror("evloop_reap: waitid");
+				res = -1;
+				break;
+			}
+			epoll_ctl(ep_fd, EPOLL_CTL_DEL, fd, NULL);
+			close(fd);
+			// the waitid(2), the epoll_ctl(2) and the close(2)
+			reap_syscalls(3);
+			reap_take(children[slot]);
+			pidfds[slot] = -1;
+			children[slot] = 0;
+			remaining--;
+		}
+	}
+
+out:
+	// reaped children's pidfds are closed, and -1, already
+	for (unsigned i = 0; i < n_pidfds; i++) {
+		if (pidfds[i] >= 0) close(pidfds[i]);
+	}
+	// loop_open() cleans up after itself when it fails
+	if (ep_fd >= 0) {
+		close(sig_fd);
+		close(ep_fd);
+	}
+	free(pidfds);
+	if (res == 0) reap_report();
+	return res;
+}
+
+static
+int
+loop_open (const sigset_t *mask, int *sig_fd)
+{
+	int ep_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (ep_fd == -1) {
+		perror("loop_open: epoll_create1");
+		return -1;
+	}
+	if ((*sig_fd = signalfd(-1, mask, SFD_NONBLOCK | SFD_CLOEXEC)) == -1) {
+		perror("loop_open: signalfd");
+		close(ep_fd);
+		return -1;
+	}
+	struct epoll_event event = { .events = EPOLLIN, .data.u64 = LOOP_SIG_SLOT };
+	if (epoll_ctl(ep_fd, EPOLL_CTL_ADD, *sig_fd, &event) == -1) {
+		perror("loop_open: epoll_ctl");
+		close(*sig_fd);
+		close(ep_fd);
+		return -1;
+	}
+	return ep_fd;
+}
+
+static
+int
+loop_read_signals (
+	int sig_fd,
+	void (*on_sig)(int),
+	pid_t *children,
+	unsigned n_children,
+	unsigned *remaining
+)
+{
+	struct signalfd_siginfo infos[16];
+	for (;;) {
+		ssize_t n_read = read(sig_fd, infos, sizeof(infos));
+		reap_syscalls(1);
+		if (n_read == -1) {
+			if (errno == EAGAIN) return 0;
+			if (errno == EINTR) continue;
+			perror("loop_read_signals: read");
+			return -1;
+		}
+		for (size_t i = 0; i < (size_t) n_read / sizeof(*infos); i++) {
+			int signum = (int) infos[i].ssi_signo;
+			if (signum != SIGCHLD) {
+				on_sig(signum);
+				logmsg_drain();
+				continue;
+			}
+			// SIGCHLD coalesces - reap everything that has exited
+			pid_t pid = 0;
+			while (remaining && *remaining > 0 && (pid = usage_wait(NULL, WNOHANG)) > 0) {
+				reap_syscalls(1);
+				long slot = reap_take(pid);
+				if (slot >= 0 && (unsigned long) slot < n_children) children[slot] = 0;
+				(*remaining)--;
+			}
+			if (pid == -1 && errno != ECHILD) {
+				perror("loop_read_signals: wait4");
+				return -1;
+			}
+		}
+	}
+}
+
+#else /* #ifdef __linux__ */
+
+int
+evloop_block_signals (const sigset_t *signals)
+{
+	(void) signals;
+	errno = ENOSYS;
+	return -1;
+}
+
+int
+evloop_await_signal (void (*on_sig)(int), const volatile sig_atomic_t *done)
+{
+	(void) on_sig;
+	(void) done;
+	errno = ENOSYS;
+	return -1;
+}
+
+int
+evloop_reap (pid_t *children, unsigned n_children, void (*on_sig)(int))
+{
+	(void) children;
+	(void) n_children;
+	(void) on_sig;
+	errno = ENOSYS;
+	return -1;
+}
+
+#endif /* #ifdef __linux__ */
@@ -0,0 +1,44 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef EVLOOP_H
+#define EVLOOP_H
+
+#include <signal.h>     // for sigset_t
+#include <sys/types.h>  // for pid_t
+
+// the event-loop wait backend: signals are blocked and read from a
+// signalfd, child exits arrive via pidfds (or SIGCHLD, without them), all on
+// one epoll set - so each process wakes exactly once per event
+//
+// every function returns 0, or -1 with errno set - ENOSYS off Linux
+
+// block signals, and SIGCHLD, so they queue for the event loop
+// call before forking, so nothing slips in before a child sets up its loop
+int
+evloop_block_signals (const sigset_t *signals);
+
+// pass the blocked signals to on_sig as they arrive, until it sets *done
+int
+evloop_await_signal (void (*on_sig)(int), const volatile sig_atomic_t *done);
+
+// reap all n_children children, zeroing each as it is reaped, and passing
+// any blocked signals that arrive meanwhile to on_sig
+int
+evloop_reap (pid_t *children, unsigned n_children, void (*on_sig)(int));
+
+#endif /* #ifndef EVLOOP_H */
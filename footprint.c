@@ -0,0 +1,92 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
+#endif /* #ifndef _XOPEN_SOURCE */
+
+#include <errno.h>      // for errno itself
+#include <fcntl.h>      // for open(2)
+#include <string.h>     // for strncmp(3), strlen(3)
+#include <unistd.h>     // for close(2), read(2)
+
+#include "footprint.h"
+#include "log.h"
+#include "timing.h"
+
+// the rollup is a header line and a couple of dozen fields - read with no
+// stdio and no allocation, so as not to grow what it measures
+#define ROLLUP_MAX 2048U
+
+static
+unsigned long
+field_kb (const char *buf, const char *name);
+
+int
+footprint_report (void)
+{
+#ifdef __linux__
+	int fd = open("/proc/self/smaps_rollup", O_RDONLY | O_CLOEXEC);
+	if (fd == -1) return -1;
+	char buf[ROLLUP_MAX];
+	size_t len = 0;
+	ssize_t n_read;
+	while (len < sizeof(buf) - 1U) {
+		n_read = read(fd, buf + len, sizeof(buf) - 1U - len);
+		if (n_read == -1 && errno == EINTR) continue;
+		if (n_read <= 0) break;
+		len += (size_t) n_read;
+	}
+	int saved_errno = errno;
+	close(fd);
+	if (len == 0) {
+		errno = n_read == 0 ? ENOSYS : saved_errno;
+		return -1;
+	}
+	buf[len] = '\0';
+
+	unsigned long rss_kb = field_kb(buf, "Rss:");
+	unsigned long pss_kb = field_kb(buf, "Pss:");
+	unsigned long dirty_kb = field_kb(buf, "Private_Dirty:");
+	logmsg("rss %lu kB, pss %lu kB, private dirty %lu kB", rss_kb, pss_kb, dirty_kb);
+	timing_footprint(rss_kb, pss_kb, dirty_kb);
+	return 0;
+#else
+	errno = ENOSYS;
+	return -1;
+#endif /* #ifdef __linux__ */
+}
+
+static
+unsigned long
+field_kb (const char *buf, const char *name)
+{
+	// "Name:           1234 kB", one to a line
+	size_t name_len = strlen(name);
+	for (const char *line = buf; *line; ) {
+		if (strncmp(line, name, name_len) == 0) {
+			const char *cur = line + name_len;
+			while (*cur == ' ' || *cur == '\t') cur++;
+			unsigned long kb = 0;
+			while (*cur >= '0' && *cur <= '9') kb = kb * 10U + (unsigned long) (*cur++ - '0');
+			return kb;
+		}
+		while (*line && *line != '\n') line++;
+		if (*line) line++;
+	}
+	return 0;
+}
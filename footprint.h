@@ -0,0 +1,32 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef FOOTPRINT_H
+#define FOOTPRINT_H
+
+// what each process of the stack costs in memory, as the kernel accounts it
+// in /proc/self/smaps_rollup (Linux 4.14+): its resident set, its
+// proportional share of pages it shares with the rest of the tree - which
+// adds up across the tree to what it really costs - and what it has dirtied
+// of its own
+
+// read our footprint and report it, in the log and as a timing record
+// returns 0, or -1 with errno set - ENOSYS off Linux
+int
+footprint_report (void);
+
+#endif /* #ifndef FOOTPRINT_H */
@@ -0,0 +1,194 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif /* #ifndef _GNU_SOURCE */
+#endif /* #ifdef __linux__ */
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
+#endif /* #ifndef _XOPEN_SOURCE */
+
+#include <errno.h>          // for errno itself
+#include <stdint.h>         // for uint64_t, uintptr_t
+#include <stdio.h>          // for perror(3), snprintf(3)
+#include <stdlib.h>         // for strtoul(3)
+#include <string.h>         // for strchr(3), strcmp(3)
+#include <sys/mman.h>       // for madvise(2), mmap(2), munmap(2)
+#include <sys/resource.h>   // for getrusage(2)
+#include <unistd.h>         // for sysconf(3)
+
+#include "heap.h"
+#include "log.h"
+#include "timing.h"
+
+// transparent huge pages come in aligned runs of this on x86-64 and arm64
+#define HUGE_PAGE_SIZE (2UL << 20)
+
+static
+unsigned char *
+heap = NULL;
+
+static
+size_t
+heap_size = 0;
+
+static
+unsigned
+heap_flags = 0;
+
+static
+long
+minor_faults (void);
+
+static
+void
+touch_pages (uint64_t *ns, long *faults);
+
+int
+heap_parse (const char *str, unsigned *mb, unsigned *flags)
+{
+	char buf[64];
+	if (snprintf(buf, sizeof(buf), "%s", str) >= (int) sizeof(buf)) return -1;
+
+	*flags = 0;
+	char *next = strchr(buf, ',');
+	if (next) *next++ = '\0';
+	while (next) {
+		char *flag = next;
+		if ((next = strchr(flag, ','))) *next++ = '\0';
+		if (strcmp(flag, "huge") == 0) *flags |= HEAP_HUGE;
+		else if (strcmp(flag, "dontfork") == 0) *flags |= HEAP_DONTFORK;
+		else if (strcmp(flag, "wipeonfork") == 0) *flags |= HEAP_WIPEONFORK;
+		else return -1;
+	}
+	// a region is either left out of the child or zeroed in it
+	if ((*flags & HEAP_DONTFORK) && (*flags & HEAP_WIPEONFORK)) return -1;
+
+	char *end = NULL;
+	errno = 0;
+	unsigned long val = strtoul(buf, &end, 10);
+	if (errno || end == buf || *end != '\0' || val < 1 || val > SIZE_MAX >> 21) {
+		return -1;
+	}
+	*mb = (unsigned) val;
+	return 0;
+}
+
+int
+heap_init (unsigned mb, unsigned flags, int top_of_stack)
+{
+	if (!top_of_stack) return 0;
+
+	heap_size = (size_t) mb << 20;
+	heap_flags = flags;
+	// huge pages only back aligned runs - map enough to align the start
+	size_t map_size = heap_size + ((flags & HEAP_HUGE) ? HUGE_PAGE_SIZE : 0);
+	unsigned char *map = mmap(
+		NULL,
+		map_size,
+		PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS,
+		-1,
+		0
+	);
+	if (map == MAP_FAILED) return -1;
+	heap = map;
+	if (flags & HEAP_HUGE) {
+		uintptr_t start = ((uintptr_t) map + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+		heap = (unsigned char *) start;
+		if (heap > map) munmap(map, (size_t) (heap - map));
+		if (map + map_size > heap + heap_size) {
+			munmap(heap + heap_size, (size_t) (map + map_size - (heap + heap_size)));
+		}
+	}
+
+#ifdef __linux__
+	// advice is best effort - the heap is still worth forking without it
+	if ((flags & HEAP_HUGE) && madvise(heap, heap_size, MADV_HUGEPAGE) == -1) {
+		perror("heap_init: madvise(MADV_HUGEPAGE)");
+	}
+	if ((flags & HEAP_DONTFORK) && madvise(heap, heap_size, MADV_DONTFORK) == -1) {
+		perror("heap_init: madvise(MADV_DONTFORK)");
+	}
+#ifdef MADV_WIPEONFORK
+	if ((flags & HEAP_WIPEONFORK) && madvise(heap, heap_size, MADV_WIPEONFORK) == -1) {
+		perror("heap_init: madvise(MADV_WIPEONFORK)");
+	}
+#else
+	if (flags & HEAP_WIPEONFORK) logmsg("MADV_WIPEONFORK not supported, ignored");
+#endif /* #ifdef MADV_WIPEONFORK */
+#else
+	if (flags) logmsg("heap advice is Linux only, ignored");
+#endif /* #ifdef __linux__ */
+
+	uint64_t ns;
+	long faults;
+	touch_pages(&ns, &faults);
+	logmsg(
+		"heap of %u MiB touched: %ld faults in %llu us",
+		mb,
+		faults,
+		(long long unsigned) (ns / 1000)
+	);
+	timing_heap((unsigned long) (heap_size >> 10), faults, ns);
+	return 0;
+}
+
+void
+heap_touch (void)
+{
+	// left out of the child - nothing there to touch
+	if (heap == NULL) return;
+	if (heap_flags & HEAP_DONTFORK) {
+		heap = NULL;
+		timing_heap(0, 0, 0);
+		return;
+	}
+
+	uint64_t ns;
+	long faults;
+	touch_pages(&ns, &faults);
+	timing_heap((unsigned long) (heap_size >> 10), faults, ns);
+}
+
+static
+long
+minor_faults (void)
+{
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == -1) return 0;
+	return usage.ru_minflt;
+}
+
+static
+void
+touch_pages (uint64_t *ns, long *faults)
+{
+	// one write per page is all it takes to fault each in, or copy it - a
+	// read first would fault the zero page in ahead of it
+	size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+	long faults_before = minor_faults();
+	uint64_t start = timing_now();
+	for (size_t offset = 0; offset < heap_size; offset += page_size) {
+		((volatile unsigned char *) heap)[offset] = 1;
+	}
+	*ns = timing_now() - start;
+	*faults = minor_faults() - faults_before;
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef HEAP_H
+#define HEAP_H
+
+// a heap the size of a real supervisor's, so that forking the stack costs
+// what forking one does: every page is touched up front, and every child a
+// fork-like engine creates writes to every page it inherited, taking the
+// copy-on-write faults a busy process would
+
+// what to do with the heap, or'd together
+enum heap_flags {
+	HEAP_HUGE = 1,          // back it with transparent huge pages
+	HEAP_DONTFORK = 2,      // MADV_DONTFORK: children inherit none of it
+	HEAP_WIPEONFORK = 4,    // MADV_WIPEONFORK: children inherit it zeroed
+};
+
+// -H: parse mb[,huge][,dontfork|,wipeonfork] into a size and flags
+// returns 0, or -1 if str is not one
+int
+heap_parse (const char *str, unsigned *mb, unsigned *flags);
+
+// map and touch an mb MiB heap, if we are the top of the stack - anything
+// exec'd beneath it starts without one - and report what that took
+// returns 0, or -1 with errno set
+int
+heap_init (unsigned mb, unsigned flags, int top_of_stack);
+
+// in a freshly forked child, write to every page of the heap it inherited,
+// and report the faults and time that took
+void
+heap_touch (void);
+
+#endif /* #ifndef HEAP_H */
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// for wait4(2)
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif /* #ifndef _DEFAULT_SOURCE */
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
+#endif /* #ifndef _XOPEN_SOURCE */
+
+#include <errno.h>      // for errno itself
+#include <stdint.h>     // for uint64_t
+#include <stdio.h>      // for perror(3)
+#include <sys/resource.h> // for struct rusage
+#include <sys/wait.h>   // for wait4(2), waitid(2)
+
+#ifdef __linux__
+#include <sys/prctl.h>  // for prctl(2)
+#endif /* #ifdef __linux__ */
+
+#include "init.h"
+#include "log.h"
+#include "probes.h"
+#include "reap.h"
+#include "stack.h"
+#include "stats.h"
+#include "usage.h"
+
+int
+init_become_subreaper (void)
+{
+#ifdef __linux__
+	return prctl(PR_SET_CHILD_SUBREAPER, 1UL, 0UL, 0UL, 0UL);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif /* #ifdef __linux__ */
+}
+
+int
+init_reap (
+	pid_t *children,
+	unsigned n_children,
+	void (*on_wake)(const pid_t *children, unsigned n_children),
+	int (*on_failed)(unsigned slot, int status),
+	int *last_status
+)
+{
+	// a child respawned after on_failed stopped us is waited on afresh
+	unsigned remaining = 0;
+	for (unsigned i = 0; i < n_children; i++) {
+		if (children[i]) remaining++;
+	}
+	unsigned long n_orphans = 0;
+	while (remaining > 0) {
+		// sleep until something exits, without reaping it yet...
+		siginfo_t info;
+		STACK_PROBE2(wait__entry, fork_id, remaining);
+		uint64_t wait_start = stats_wait_begin();
+		int ret = waitid(P_ALL, 0, &info, WEXITED | WNOWAIT);
+		STACK_PROBE2(wait__return, fork_id, ret == -1 ? -1 : info.si_pid);
+		stats_wait_end(wait_start, ret == -1 && errno == EINTR);
+		reap_syscalls(1);
+		if (ret == -1) {
+			if (errno == EINTR) {
+				STACK_PROBE2(eintr, fork_id, "init_reap");
+				logmsg_drain();
+				on_wake(children, n_children);
+				continue;
+			}
+			perror("init_reap: waitid");
+			return -1;
+		}
+		reap_woke();
+
+		// ...then reap everything that has exited by now in one go
+		for (;;) {
+			int status = 0;
+			struct rusage usage;
+			pid_t pid = wait4(-1, &status, WNOHANG, &usage);
+			reap_syscalls(1);
+			if (pid == -1) {
+				if (errno == EINTR) continue;
+				if (errno == ECHILD) break;
+				perror("init_reap: wait4");
+				return -1;
+			}
+			// WNOHANG returns 0 once nothing else has exited
+			if (pid == 0) break;
+
+			long slot = reap_take(pid);
+			if (slot >= 0) {
+				children[slot] = 0;
+				remaining--;
+				if (last_status) *last_status = status;
+			}
+			else {
+				n_orphans++;
+			}
+			// an orphan could have come from anywhere beneath us
+			usage_reaped(slot >= 0 ? fork_id - 1 : 0, WIFSIGNALED(status), &usage);
+			if (slot >= 0 && on_failed(slot, status)) {
+				if (n_orphans) logmsg("reaped %lu orphaned descendants", n_orphans);
+				return 1;
+			}
+		}
+		on_wake(children, n_children);
+	}
+
+	if (n_orphans) {
+		logmsg("reaped %lu orphaned descendants", n_orphans);
+	}
+	reap_report();
+	return 0;
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef INIT_H
+#define INIT_H
+
+#include <sys/types.h>  // for pid_t
+
+// the top of the stack as a minimal init: it adopts orphaned descendants and
+// reaps them in batches, so they never pile up as zombies
+
+// have orphaned descendants reparented to us rather than to the system's
+// init
+// returns 0, or -1 with errno set - ENOSYS off Linux
+int
+init_become_subreaper (void);
+
+// reap until all n_children children - each given to reap_add() - have
+// exited, along with any orphans that exit meanwhile. Reaped children's
+// entries are zeroed
+// on_wake is called after every batch and signal interruption, with the
+// children still running. The wait status of the last of them to exit is
+// stored in status, if it is not NULL. on_failed is given each child's slot
+// and wait status as it is reaped, and stops the reaping if it returns
+// non-zero, to have that child respawned
+// returns 0, 1 if on_failed stopped it, or -1 with errno set
+int
+init_reap (
+	pid_t *children,
+	unsigned n_children,
+	void (*on_wake)(const pid_t *children, unsigned n_children),
+	int (*on_failed)(unsigned slot, int status),
+	int *status
+);
+
+#endif /* #ifndef INIT_H */
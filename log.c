@@ -0,0 +1,272 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
+#endif /* #ifndef _XOPEN_SOURCE */
+
+#include <errno.h>      // for errno itself
+#include <stdarg.h>     // for stdarg(3)
+#include <stdatomic.h>  // for atomic_uint
+#include <stdio.h>      // for perror(3), snprintf(3)
+#include <sys/uio.h>    // for writev(2)
+#include <unistd.h>     // for getpid(3), write(2)
+
+#include "log.h"
+#include "stack.h"
+
+#if (LOG_RING_SIZE & (LOG_RING_SIZE - 1U)) != 0U || LOG_RING_SIZE == 0U
+#error LOG_RING_SIZE must be a power of two
+#endif /* #if (LOG_RING_SIZE & (LOG_RING_SIZE - 1U)) != 0U ... */
+
+// signal handlers may only touch lock-free atomics
+#if ATOMIC_INT_LOCK_FREE != 2
+#error atomic_uint is not lock-free on this platform
+#endif /* #if ATOMIC_INT_LOCK_FREE != 2 */
+
+#if LOG_LINE_MAX < 128
+#error LOG_LINE_MAX must leave room for the preamble
+#endif /* #if LOG_LINE_MAX < 128 */
+
+// "fork #%3u (pid %llu):\t" for this process, formatted by logmsg_init()
+// per thread, like fork_id
+static _Thread_local
+char
+preamble[64];
+
+static _Thread_local
+size_t
+preamble_len = 0;
+
+// our pid as of logmsg_init() - saves a getpid(2) per record drained
+static _Thread_local
+pid_t
+preamble_pid = 0;
+
+// one message queued by logmsg_async()
+// everything but seq is plain data, published to the reader by the release
+// store to seq
+struct log_record {
+	atomic_uint seq;    // ring position + 1 once this record is readable
+	const char *msg;
+	unsigned fork_id;
+	pid_t pid;
+};
+
+static
+struct log_record
+ring[LOG_RING_SIZE];
+
+// next ring position a writer may reserve
+static
+atomic_uint
+ring_head;
+
+// next ring position logmsg_drain() will read
+static
+atomic_uint
+ring_tail;
+
+// records thrown away because the ring was full
+static
+atomic_uint
+ring_dropped;
+
+static
+void
+write_all (const char *buf, size_t len);
+
+static
+void
+writev_all (struct iovec *iov, int n_iov);
+
+void
+logmsg_init (void)
+{
+	preamble_pid = getpid();
+	int written = snprintf(
+		preamble,
+		sizeof(preamble),
+		"fork #%3u (pid %llu):\t",
+		fork_id,
+		(long long unsigned) preamble_pid
+	);
+	// sized for any fork_id and pid - a failure here is a programming error
+	if (written < 0 || (size_t) written >= sizeof(preamble)) {
+		preamble_len = 0;
+		fprintf(stderr, "logmsg_init: preamble buffer overflow\n");
+		return;
+	}
+	preamble_len = (size_t) written;
+}
+
+void
+logmsg (const char *fmt, ...)
+{
+	if (fmt == NULL) return;
+
+	// keep anything the signal handlers queued ahead of us in order
+	logmsg_drain();
+	if (preamble_len == 0) logmsg_init();
+
+	// messages are capped at LOG_LINE_MAX, preamble included, so that each
+	// is a single write(2) - atomic on a pipe, and never interleaved
+	char body[LOG_LINE_MAX];
+	size_t body_max = sizeof(body) - preamble_len;
+	va_list vargs;
+	va_start(vargs, fmt);
+	int written = vsnprintf(body, body_max - 1U, fmt, vargs);
+	va_end(vargs);
+	if (written < 0) {
+		perror("logmsg: vsnprintf");
+		return;
+	}
+
+	// possibly truncated - the linebreak goes in either way
+	size_t body_len = (size_t) written < body_max - 2U ? (size_t) written : body_max - 2U;
+	body[body_len++] = '\n';
+
+	struct iovec iov[2] = {
+		{ .iov_base = preamble, .iov_len = preamble_len },
+		{ .iov_base = body, .iov_len = body_len },
+	};
+	writev_all(iov, 2);
+}
+
+void
+logmsg_async (const char *msg)
+{
+	// reserve a slot - we may be racing a handler for another signal that
+	// interrupted us, so claim it with a CAS rather than a plain store
+	unsigned head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+	do {
+		unsigned tail = atomic_load_explicit(&ring_tail, memory_order_acquire);
+		if (head - tail >= LOG_RING_SIZE) {
+			atomic_fetch_add_explicit(&ring_dropped, 1U, memory_order_relaxed);
+			return;
+		}
+	} while (!atomic_compare_exchange_weak_explicit(
+		&ring_head,
+		&head,
+		head + 1U,
+		memory_order_relaxed,
+		memory_order_relaxed
+	));
+
+	struct log_record *rec = &ring[head % LOG_RING_SIZE];
+	rec->msg = msg;
+	rec->fork_id = fork_id;
+	rec->pid = getpid();
+	atomic_store_explicit(&rec->seq, head + 1U, memory_order_release);
+}
+
+void
+logmsg_drain (void)
+{
+	unsigned tail = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+	for (;;) {
+		struct log_record *rec = &ring[tail % LOG_RING_SIZE];
+		// stop at the first slot that is reserved but not yet published -
+		// its writer is whatever we interrupted, and will finish before we
+		// are next called
+		if (atomic_load_explicit(&rec->seq, memory_order_acquire) != tail + 1U) {
+			break;
+		}
+		const char *msg = rec->msg;
+		unsigned rec_fork_id = rec->fork_id;
+		pid_t pid = rec->pid;
+		atomic_store_explicit(&ring_tail, ++tail, memory_order_release);
+
+		// records queued before a fork are our parent's to print
+		if (pid != (preamble_len ? preamble_pid : getpid())) continue;
+
+		char buf[256];
+		int written = snprintf(
+			buf,
+			sizeof(buf),
+			"fork #%3u (pid %llu):\t%s\n",
+			rec_fork_id,
+			(long long unsigned) pid,
+			msg
+		);
+		if (written < 0) continue;
+		if ((size_t) written >= sizeof(buf)) {
+			written = sizeof(buf) - 1;
+			buf[written - 1] = '\n';
+		}
+		write_all(buf, (size_t) written);
+	}
+
+	unsigned dropped = atomic_exchange_explicit(
+		&ring_dropped,
+		0U,
+		memory_order_relaxed
+	);
+	if (dropped) {
+		char buf[128];
+		int written = snprintf(
+			buf,
+			sizeof(buf),
+			"fork #%3u (pid %llu):\tdropped %u log records\n",
+			fork_id,
+			(long long unsigned) getpid(),
+			dropped
+		);
+		if (written > 0 && (size_t) written < sizeof(buf)) {
+			write_all(buf, (size_t) written);
+		}
+	}
+}
+
+static
+void
+write_all (const char *buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t written = write(STDERR_FILENO, buf, len);
+		if (written < 0) {
+			if (errno == EINTR) continue;
+			return;
+		}
+		buf += written;
+		len -= (size_t) written;
+	}
+}
+
+static
+void
+writev_all (struct iovec *iov, int n_iov)
+{
+	while (n_iov > 0) {
+		ssize_t written = writev(STDERR_FILENO, iov, n_iov);
+		if (written < 0) {
+			if (errno == EINTR) continue;
+			return;
+		}
+		// only a full pipe or a signal leaves a write short - pick up where
+		// it left off
+		while (n_iov > 0 && (size_t) written >= iov->iov_len) {
+			written -= (ssize_t) iov->iov_len;
+			iov++;
+			n_iov--;
+		}
+		if (n_iov > 0) {
+			iov->iov_base = (char *) iov->iov_base + written;
+			iov->iov_len -= (size_t) written;
+		}
+	}
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef LOG_H
+#define LOG_H
+
+// number of records the async log ring holds before it starts dropping them
+#ifndef LOG_RING_SIZE
+#define LOG_RING_SIZE 256U
+#endif /* #ifndef LOG_RING_SIZE */
+
+// longest line logmsg() writes, preamble and linebreak included - longer
+// messages are truncated
+#ifndef LOG_LINE_MAX
+#define LOG_LINE_MAX 4096
+#endif /* #ifndef LOG_LINE_MAX */
+
+// format this process's preamble, once - call again whenever fork_id or our
+// pid changes, which is to say right after a fork
+void
+logmsg_init (void);
+
+// format and write a message to stderr, after draining any pending records,
+// with a single writev(2) and no allocation
+// not async-signal-safe
+void
+logmsg (const char *fmt, ...);
+
+// queue msg, which must have static storage duration, for a later
+// logmsg_drain()
+// async-signal-safe, lock-free and allocation-free
+void
+logmsg_async (const char *msg);
+
+// format and write all pending records queued by logmsg_async() to stderr
+// we are the only reader - call from normal context only
+void
+logmsg_drain (void);
+
+#endif /* #ifndef LOG_H */
@@ -20,33 +20,352 @@
 #endif /* #ifndef _XOPEN_SOURCE */
 
 #include <errno.h>      // for errno itself
-#include <signal.h>     // for kill(3), raise(3), signal(3)
-#include <stdarg.h>     // for stdarg(3)
-#include <stdlib.h>     // for exit(3)
+#include <fcntl.h>      // for fcntl(2)
+#include <limits.h>     // for INT_MAX, UINT_MAX
+#include <signal.h>     // for kill(3), sigaction(2), signal(3), sigsuspend(2)
+#include <stdint.h>     // for uint64_t
+#include <stdlib.h>     // for exit(3), strtoul(3)
 #include <stdio.h>      // for perror(3), printf(3)
-#include <string.h>     // for strerror(3)
-#include <sys/wait.h>   // for waitpid(2)
-#include <unistd.h>     // for _exit(3), fork(2), getpid(3), sysconf(3)
+#include <string.h>     // for memset(3), strchr(3), strcmp(3)
+#include <sys/wait.h>   // for WEXITSTATUS, WIFSIGNALED, WTERMSIG, waitid(2), waitpid(2)
+#include <time.h>       // for nanosleep(2)
+#include <unistd.h>     // for _exit(3), execvp(3), fork(2), getopt(3), pipe(2)
 
+#include "board.h"
+#include "broadcast.h"
+#include "drain.h"
+#include "evloop.h"
+#include "footprint.h"
+#include "heap.h"
+#include "init.h"
+#include "log.h"
+#include "pidfd.h"
+#include "placement.h"
+#include "probes.h"
+#include "ready.h"
+#include "reap.h"
+#include "rtsig.h"
+#include "shared.h"
+#include "sigpolicy.h"
+#include "spawn.h"
+#include "stack.h"
+#include "stats.h"
+#include "storm.h"
+#include "threads.h"
+#include "timing.h"
+#include "trace.h"
+#include "uring.h"
+#include "usage.h"
+#include "warm.h"
+
+// default depth of the stack, overridable at runtime with -d
 #ifndef N_CHILDREN
 #define N_CHILDREN 3U
 #endif /* #ifndef N_CHILDREN */
 
-#if N_CHILDREN > 128U
-#error Invalid N_CHILDREN
-#endif /* #if N_CHILDREN > 128U */
+// refuse to build trees larger than this many processes in total
+#ifndef MAX_PROCESSES
+#define MAX_PROCESSES 65536UL
+#endif /* #ifndef MAX_PROCESSES */
 
-static volatile
+_Thread_local volatile
 unsigned
 fork_id = N_CHILDREN;
 
+// children forked by each interior level of the tree
+static
+unsigned
+fanout = 1U;
+
+// how interior levels wait on their children and leaves wait on a signal
+enum wait_backend {
+	WAIT_CLASSIC,   // signal handlers, blocking wait4 and sigsuspend
+	WAIT_EPOLL,     // signalfd and pidfds on one epoll set - see evloop.h
+	WAIT_PIDFD,     // signal handlers, children polled via pidfds
+	WAIT_URING,     // signalfd, waitid and the drain timer on one io_uring - see uring.h
+	N_WAIT_BACKENDS
+};
+
+static const char *const
+wait_backend_names[N_WAIT_BACKENDS] = {
+	[WAIT_CLASSIC] = "classic",
+	[WAIT_EPOLL] = "epoll",
+	[WAIT_PIDFD] = "pidfd",
+	[WAIT_URING] = "uring",
+};
+
+static
+enum wait_backend
+wait_backend = WAIT_CLASSIC;
+
+// -s: how each level creates its children
+static
+enum spawn_engine
+spawn_engine = SPAWN_FORK;
+
+// -i: run the top of the stack as a minimal init
+static
+int
+init_mode = 0;
+
+// a signal the init has caught, but not yet forwarded
+static volatile
+sig_atomic_t
+forward_signum = 0;
+
+// -g: forward the first fatal signal caught to the whole process group - or,
+// with a forward action in -A, the ones it names
+static
+int
+group_broadcast = 0;
+
+// -A: whether any signal was given an action of its own
+static
+int
+signal_policy = 0;
+
+// -D: how long our children get to exit once we are signaled, before we
+// escalate - 0 waits forever
+static
+unsigned
+drain_deadline_ms = 0;
+
+// -q: catch realtime-signal probes on SIGRTMIN plus this, if set
+static
+int
+rtsig_offset = -1;
+
+// -z: count storm signals - and with STORM_LOG, log every one
+enum storm_mode {
+	STORM_OFF,
+	STORM_COUNT,
+	STORM_LOG,
+	N_STORM_MODES
+};
+
+static const char *const
+storm_mode_names[N_STORM_MODES] = {
+	[STORM_OFF] = "off",
+	[STORM_COUNT] = "count",
+	[STORM_LOG] = "log",
+};
+
+static
+enum storm_mode
+storm_mode = STORM_OFF;
+
+// -a: pin each level to a CPU list of its own, or -N: spread the levels
+// across NUMA nodes
+static
+const char *
+placement_cpus = NULL;
+
+static
+int
+placement_numa = 0;
+
+// -r: run the leaves SCHED_FIFO at this priority, if set
+static
+unsigned
+leaf_priority = 0;
+
+// -l: warm each process up and lock it in memory ahead of its first signal
+static
+int
+warm_mode = 0;
+
+// -c: keep live counters, dumped on SIGUSR1
+static
+int
+stats_mode = 0;
+
+// -m: report each process's memory footprint at exit
+static
+int
+footprint_mode = 0;
+
+// -H: the MiB of heap to fork with, and what to advise the kernel of it
+static
+unsigned
+heap_mb = 0, heap_flags = 0;
+
+// -b: publish what every process is doing on the status board
+static
+int
+status_board = 0;
+
+// -B: only read the board of this pid, every board_interval_ms
+static
+pid_t
+board_reader_pid = 0;
+
+static
+unsigned
+board_interval_ms = 0;
+
+// -- command: what the leaves exec in place of awaiting a signal - the
+// levels above forward every terminating signal down to it, and end the way
+// it did
+static
+char **
+exec_argv = NULL;
+
+// the wait status of the last of our children reaped, for exec_argv
+static
+int
+child_status = 0;
+
+// -k: respawn a child that fails, up to max_restarts times - the first time
+// after restart_backoff_ms, doubling each time up to restart_backoff_max_ms
+static
+unsigned
+max_restarts = 0;
+
+static
+unsigned
+restart_backoff_ms = 10U, restart_backoff_max_ms = 1000U;
+
+// -K: keep a child forked ahead of time, parked until one fails
+static
+int
+keep_standby = 0;
+
+// respawns so far, and the slot of the child that last failed and when it
+// was reaped
+static
+unsigned
+n_restarts = 0, failed_slot = 0;
+
+static
+uint64_t
+failed_ns = 0;
+
+// children that died before reporting their subtree up, holding our own
+// report back until respawns replace them
+static
+unsigned
+n_unready = 0;
+
+// the parked standby, the pipe that wakes it and the one it reports ready on
+static
+pid_t
+standby_pid = 0;
+
+static
+int
+standby_wake_fd = -1, standby_ready_fd = -1;
+
+// -p: run the levels as threads of this one process instead
+static
+int
+thread_mode = 0;
+
+// -T: record every process's events in the binary trace at this path
+static
+const char *
+trace_path = NULL;
+
+// -u: account for the resources each level of the tree uses
+static
+int
+usage_accounting = 0;
+
+// set until we are forked - only the top of the stack keeps it
+static
+int
+top_of_stack = 1;
+
+// pids of our children, zeroed as they are reaped
+static
+pid_t *
+children = NULL;
+
+#ifdef STACK_MINIMAL
+// the minimal build allocates nothing - pages of this no level touches cost
+// it nothing either
+static
+pid_t
+children_storage[MAX_PROCESSES];
+#endif /* #ifdef STACK_MINIMAL */
+
+// shape of the whole tree, as computed by parse_args()
+static
+unsigned
+stack_depth = N_CHILDREN;
+
+static
+unsigned long
+n_leaves = 1UL, n_processes = 1UL;
+
 static volatile
 sig_atomic_t
 fatal_signum = 0;
 
+static
+int
+parse_uint (const char *str, unsigned *out);
+
+static
+int
+parse_board_reader (const char *str);
+
+static
+int
+parse_restarts (const char *str);
+
+static
+void
+usage (const char *argv0);
+
+static
+int
+parse_args (int argc, char **argv);
+
+static
+void
+init_forward_signal (const pid_t *children, unsigned n_children);
+
+static
+int
+await_children (pid_t *children, unsigned n_children);
+
+static
+int
+await_signal (void);
+
+static
+int
+reap_children (pid_t *children, unsigned n_children);
+
+static
+int
+exec_command (void);
+
+static
+void
+become_child (int ready_fds[2]);
+
+// -k: whether the child reaped from slot with status is to be respawned -
+// noting which, and when, if it is
+static
+int
+child_failed (unsigned slot, int status);
+
+static
+pid_t
+respawn_child (pid_t *children);
+
+static
+pid_t
+fork_standby (void);
+
+static
+void
+drop_standby (void);
+
 static
 void
-logmsg (const char *fmt, ...);
+exit_as_child (void);
 
 static
 void
@@ -57,8 +376,26 @@ void
 on_signal (int signum);
 
 int
-main (void)
+main (int argc, char **argv)
 {
+	uint64_t started = timing_now();
+	if (parse_args(argc, argv) == -1) {
+		return EXIT_FAILURE;
+	}
+	logmsg_init();
+	if (board_reader_pid) {
+		if (board_read(board_reader_pid, board_interval_ms) == -1) {
+			perror("main: board_read");
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+	ready_init(started);
+	if (spawn_init(spawn_engine, argc, argv) == -1) {
+		perror("main: spawn_init");
+		return EXIT_FAILURE;
+	}
+
 	// register a function to log on exit and re-raise any fatal signal we
 	// received
 	if (atexit(on_exit) == -1) {
@@ -66,142 +403,991 @@ main (void)
 		return EXIT_FAILURE;
 	}
 
-	// register a signal handler to log and record any fatal signal we receive
-	// for later re-raising
-	if (signal(SIGINT, on_signal) == SIG_ERR) {
-		perror("main: signal");
+	// install the signal policy table, with a handler to log and record any
+	// fatal signal we receive for later re-raising - as an init, or wrapping a
+	// command, catching every terminating signal, since as pid 1 we would
+	// otherwise ignore them. The init's own children, when they exec, get
+	// every signal to the group a second time from the init
+	if (sigpolicy_install(
+		on_signal,
+		(init_mode && top_of_stack) || exec_argv,
+		init_mode && !top_of_stack && fork_id + 1U == stack_depth
+	) == -1) {
+		perror("main: sigpolicy_install");
+		return EXIT_FAILURE;
+	}
+
+	// the same tree as threads, which take the signal with sigwait(3) rather
+	// than this handler
+	if (thread_mode) {
+		timing_header(fork_id, n_leaves, n_processes);
+		int signum = threads_run(fork_id, fanout, n_leaves);
+		if (signum == -1) {
+			perror("main: threads_run");
+			return EXIT_FAILURE;
+		}
+		fatal_signum = signum;
+		return EXIT_SUCCESS;
+	}
+
+	if (rtsig_offset >= 0 && rtsig_init((unsigned) rtsig_offset) == -1) {
+		perror("main: rtsig_init");
+		return EXIT_FAILURE;
+	}
+
+	// as an init, make sure orphans are reparented to us, so that we can reap
+	// them
+	if (init_mode && top_of_stack) {
+		if (init_become_subreaper() == -1) {
+			perror("main: init_become_subreaper");
+		}
+	}
+
+	if (placement_init(stack_depth, placement_cpus, placement_numa, leaf_priority) == -1) {
+		perror("main: placement_init");
 		return EXIT_FAILURE;
 	}
+	// a level that cannot be placed still runs - just not where it was asked
+	if (placement_apply() == -1) perror("main: placement_apply");
+
+	// the broadcast flag has to be shared before anyone is forked
+	if (group_broadcast && broadcast_init() == -1) {
+		perror("main: broadcast_init");
+		return EXIT_FAILURE;
+	}
+
+	// as is the usage table, which exec'd children find again
+	if (usage_accounting && usage_init(fork_id, top_of_stack) == -1) {
+		perror("main: usage_init");
+		return EXIT_FAILURE;
+	}
+	// and the live counters
+	if (stats_mode && stats_init(fork_id, n_processes - n_leaves, top_of_stack) == -1) {
+		perror("main: stats_init");
+		return EXIT_FAILURE;
+	}
+
+	if (status_board) {
+		if (board_init(n_processes, top_of_stack) == -1) {
+			perror("main: board_init");
+			return EXIT_FAILURE;
+		}
+		board_claim();
+	}
+
+	if (trace_path) {
+		if (trace_open(trace_path, n_processes, fanout, top_of_stack) == -1) {
+			perror("main: trace_open");
+			return EXIT_FAILURE;
+		}
+		trace_claim();
+	}
+
+	// without waitid on a ring, the event loop is the closest thing
+	if (wait_backend == WAIT_URING && uring_probe() == -1) {
+		if (errno != ENOSYS) {
+			perror("main: uring_probe");
+			return EXIT_FAILURE;
+		}
+		if (top_of_stack) logmsg("no io_uring waitid here, falling back to epoll");
+		wait_backend = WAIT_EPOLL;
+	}
+
+	// the event loop and the ring read signals rather than catching them -
+	// block them before the first fork so that every level inherits the mask
+	sigset_t handled;
+	sigemptyset(&handled);
+	sigaddset(&handled, SIGINT);
+	if (
+		storm_mode != STORM_OFF
+		&& storm_init(
+			wait_backend != WAIT_EPOLL && wait_backend != WAIT_URING,
+			storm_mode == STORM_LOG,
+			&handled
+		) == -1
+	) {
+		perror("main: storm_init");
+		return EXIT_FAILURE;
+	}
+	if (wait_backend == WAIT_EPOLL) {
+		if (evloop_block_signals(&handled) == -1) {
+			perror("main: evloop_block_signals");
+			return EXIT_FAILURE;
+		}
+	}
+	if (wait_backend == WAIT_URING) {
+		if (uring_block_signals(&handled) == -1) {
+			perror("main: uring_block_signals");
+			return EXIT_FAILURE;
+		}
+	}
 
+	// room for the pids of our children, inherited by every interior level
+#ifdef STACK_MINIMAL
+	children = children_storage;
+#else
+	if (fork_id > 1 && (children = calloc(fanout, sizeof(*children))) == NULL) {
+		perror("main: calloc");
+		return EXIT_FAILURE;
+	}
+#endif /* #ifdef STACK_MINIMAL */
+	// and for finding them by pid as they are reaped
+	if (fork_id > 1 && reap_init(fanout) == -1) {
+		perror("main: reap_init");
+		return EXIT_FAILURE;
+	}
 
-	// creating a stack of N_CHILDREN processes
-	// each waits on its child to finish. The last waits on a signal via
-	// pause()
+	// creating a tree of processes fork_id levels deep
+	// each interior level forks fanout children and waits on all of them to
+	// finish. The leaves wait on a signal via sigsuspend()
 	logmsg("started");
+	if (top_of_stack) timing_header(fork_id, n_leaves, n_processes);
+
+	// touched before the first fork, so that every fork copies it
+	if (heap_mb && heap_init(heap_mb, heap_flags, top_of_stack) == -1) {
+		perror("main: heap_init");
+		return EXIT_FAILURE;
+	}
+	// every handler but the drain's is installed by now - a level that
+	// cannot be locked in memory still runs, as does one that cannot be
+	// placed
+	if (warm_mode && warm_apply() == -1) perror("main: warm_apply");
 
 	while (fork_id > 1) {
-		pid_t child_pid = fork();
+		// our children report their subtrees ready on this
+		int ready_fds[2];
+		if (ready_open(ready_fds) == -1) {
+			perror("main: ready_open");
+			return EXIT_FAILURE;
+		}
+
+		pid_t child_pid = 0;
+		unsigned n_spawned;
+		uint64_t spawn_start = timing_now();
+		for (n_spawned = 0; n_spawned < fanout; n_spawned++) {
+			if ((child_pid = spawn_child(fork_id - 1, ready_fds[1])) <= 0) break;
+			children[n_spawned] = child_pid;
+			reap_add(child_pid, n_spawned);
+			trace_event(TRACE_SPAWNED, 0, child_pid);
+			STACK_PROBE2(spawn, fork_id, child_pid);
+		}
 		if (child_pid == -1) {
-			perror("main: fork");
+			perror("main: spawn_child");
 			return EXIT_FAILURE;
 		}
-		// we are the child process
+		if (child_pid > 0) {
+			timing_spawned(n_spawned, timing_now() - spawn_start);
+		}
+		// we are a child process
 		// keep iterating - either causing more children or breaking out
 		if (child_pid == 0) {
-			fork_id--;
-			logmsg("started");
+			become_child(ready_fds);
 			// keep iterating until there's no more children to make
 			continue;
 		}
 
 		// we are the parent process
-		// wait for our child to finish
+		// wait for all of our children to come up, then to finish
+		close(ready_fds[1]);
+		if (
+			drain_deadline_ms
+			&& drain_init(drain_deadline_ms, children, n_spawned, wait_backend != WAIT_URING) == -1
+		) {
+			perror("main: drain_init");
+			return EXIT_FAILURE;
+		}
+		// which is installed per level, after the level warmed up
+		if (warm_mode && drain_deadline_ms) warm_handlers();
+		rtsig_watch(children, n_spawned);
 		logmsg("waiting");
-		pid_t wait_res;
-		errno = 0;
-		while ((wait_res = waitpid(child_pid, NULL, 0)) < 0) {
-			// we expect to be interrupted
-			if (errno != EINTR) {
-				perror("main: wait_pid");
-				return EXIT_FAILURE;
-			}
+		board_set(BOARD_WAITING);
+		trace_event(TRACE_WAITING, 0, 0);
+		int ready = ready_await(ready_fds[0], n_spawned, &n_unready);
+		if (ready == -1) {
+			perror("main: ready_await");
+			return EXIT_FAILURE;
 		}
+		// a child already gone means the tree will never be whole
+		if (ready) ready_report();
+		if (keep_standby && (child_pid = fork_standby()) == 0) continue;
+
+		// a child that failed leaves its slot empty, for us to respawn it in
+		int reaped;
+		while ((reaped = await_children(children, n_spawned)) == 1) {
+			if ((child_pid = respawn_child(children)) == 0) break;
+		}
+		if (reaped == -1) {
+			return EXIT_FAILURE;
+		}
+		// we are the respawned child, or the standby put in its place
+		if (reaped == 1) continue;
+		drop_standby();
+		timing_mark(TIMING_REAPED);
+		trace_event(TRACE_REAPED, 0, 0);
+		if (exec_argv) exit_as_child();
 		exit(EXIT_SUCCESS);
 	}
 
+	if (exec_argv) return exec_command();
+
 	// we are the last in the stack - wait for a signal
-	logmsg("last child awaiting signal");
-	pause();
+	if (await_signal() == -1) {
+		return EXIT_FAILURE;
+	}
 	return EXIT_SUCCESS;
 }
 
+static
+int
+parse_uint (const char *str, unsigned *out)
+{
+	char *end = NULL;
+	errno = 0;
+	unsigned long val = strtoul(str, &end, 10);
+	if (errno || end == str || *end != '\0' || val > UINT_MAX) {
+		return -1;
+	}
+	*out = (unsigned) val;
+	return 0;
+}
+
+static
+int
+parse_board_reader (const char *str)
+{
+	// pid[:interval_ms]
+	char buf[32];
+	if (snprintf(buf, sizeof(buf), "%s", str) >= (int) sizeof(buf)) return -1;
+	char *colon = strchr(buf, ':');
+	if (colon) {
+		*colon = '\0';
+		if (parse_uint(colon + 1, &board_interval_ms) == -1) return -1;
+	}
+	unsigned pid;
+	if (parse_uint(buf, &pid) == -1 || pid < 1 || pid > INT_MAX) return -1;
+	board_reader_pid = (pid_t) pid;
+	return 0;
+}
+
+static
+int
+parse_restarts (const char *str)
+{
+	// restarts[:backoff_ms[:max_backoff_ms]]
+	char buf[48];
+	if (snprintf(buf, sizeof(buf), "%s", str) >= (int) sizeof(buf)) return -1;
+	char *colon = strchr(buf, ':');
+	if (colon) {
+		*colon++ = '\0';
+		char *max = strchr(colon, ':');
+		if (max) {
+			*max++ = '\0';
+			if (parse_uint(max, &restart_backoff_max_ms) == -1) return -1;
+		}
+		if (parse_uint(colon, &restart_backoff_ms) == -1) return -1;
+	}
+	if (parse_uint(buf, &max_restarts) == -1 || max_restarts < 1) return -1;
+	if (restart_backoff_max_ms < restart_backoff_ms) {
+		restart_backoff_max_ms = restart_backoff_ms;
+	}
+	return 0;
+}
+
 static
 void
-logmsg (const char *fmt, ...)
+usage (const char *argv0)
 {
-	if (fmt == NULL) return;
+	fprintf(
+		stderr,
+		"usage: %s [-a cpus | -N] [-A signal=action[,...]] [-b] [-c] [-d depth] [-D deadline_ms] [-f fanout] "
+		"[-g] [-H mb[,huge][,dontfork|,wipeonfork]] [-i] [-k restarts[:backoff_ms[:max_ms]] [-K]] [-l] [-m] [-p] [-q rt_offset] "
+		"[-r priority] [-s engine] [-t timing_fd] "
+		"[-T trace_path] [-u] [-w backend] [-z storm_mode] [-- command...]\n"
+		"       %s -B pid[:interval_ms]\n"
+		"signals: HUP, INT, QUIT, TERM, CHLD\n"
+		"actions: default, unwind, exit, forward, ignore\n"
+		"engines: fork, posix_spawn, vfork, clone3\n"
+		"backends: classic, epoll, pidfd, uring\n"
+		"storm modes: off, count, log\n",
+		argv0,
+		argv0
+	);
+}
 
-	// log messages up to _SC_PAGE_SIZE for readability (so stderr
-	// writes are more-or-less atomic)
-	static long sys_page_size = 0;
-	if (sys_page_size <= 0) {
-		errno = 0;
-		if ((sys_page_size = sysconf(_SC_PAGE_SIZE)) < 0) {
+static
+int
+parse_args (int argc, char **argv)
+{
+	unsigned depth = N_CHILDREN;
+	unsigned spawned_level = 0;
+	unsigned timing_fd, ready_fd, offset;
+	int opt;
+	// -L and -R are not for people - spawn engines that exec pass them to
+	// their children, telling them which level they start at and where to
+	// report their readiness
+	while ((opt = getopt(argc, argv, "a:A:bB:cd:D:f:gH:ik:KlL:mNpq:r:R:s:t:T:uw:z:")) != -1) {
+		switch (opt) {
+		case 'a':
+			placement_cpus = optarg;
+			break;
+		case 'A':
+			if (sigpolicy_parse(optarg) == -1) {
+				fprintf(stderr, "%s: invalid signal policy: %s\n", argv[0], optarg);
+				return -1;
+			}
+			signal_policy = 1;
+			break;
+		case 'b':
+			status_board = 1;
+			break;
+		case 'c':
+			stats_mode = 1;
+			break;
+		case 'B':
+			if (parse_board_reader(optarg) == -1) {
+				fprintf(stderr, "%s: invalid board reader: %s\n", argv[0], optarg);
+				return -1;
+			}
+			break;
+		case 'd':
+			if (parse_uint(optarg, &depth) == -1 || depth < 1) {
+				fprintf(stderr, "%s: invalid depth: %s\n", argv[0], optarg);
+				return -1;
+			}
+			break;
+		case 'D':
+			if (parse_uint(optarg, &drain_deadline_ms) == -1) {
+				fprintf(stderr, "%s: invalid deadline: %s\n", argv[0], optarg);
+				return -1;
+			}
+			break;
+		case 'f':
+			if (parse_uint(optarg, &fanout) == -1 || fanout < 1) {
+				fprintf(stderr, "%s: invalid fanout: %s\n", argv[0], optarg);
+				return -1;
+			}
+			break;
+		case 'g':
+			sigpolicy_forward_all();
+			break;
+		case 'H':
+			if (heap_parse(optarg, &heap_mb, &heap_flags) == -1) {
+				fprintf(stderr, "%s: invalid heap: %s\n", argv[0], optarg);
+				return -1;
+			}
+			break;
+		case 'i':
+			init_mode = 1;
+			break;
+		case 'k':
+			if (parse_restarts(optarg) == -1) {
+				fprintf(stderr, "%s: invalid restarts: %s\n", argv[0], optarg);
+				return -1;
+			}
+			break;
+		case 'K':
+			keep_standby = 1;
+			break;
+		case 'L':
+			if (parse_uint(optarg, &spawned_level) == -1 || spawned_level < 1) {
+				fprintf(stderr, "%s: invalid level: %s\n", argv[0], optarg);
+				return -1;
+			}
+			top_of_stack = 0;
+			break;
+		case 'l':
+			warm_mode = 1;
+			break;
+		case 'm':
+			footprint_mode = 1;
+			break;
+		case 'N':
+			placement_numa = 1;
+			break;
+		case 'p':
+			thread_mode = 1;
+			break;
+		case 'q':
+			if (parse_uint(optarg, &offset) == -1 || offset > INT_MAX) {
+				fprintf(stderr, "%s: invalid realtime signal: %s\n", argv[0], optarg);
+				return -1;
+			}
+			rtsig_offset = (int) offset;
+			break;
+		case 'r':
+			if (
+				parse_uint(optarg, &leaf_priority) == -1
+				|| leaf_priority < 1
+				|| leaf_priority > 99
+			) {
+				fprintf(stderr, "%s: invalid realtime priority: %s\n", argv[0], optarg);
+				return -1;
+			}
+			break;
+		case 'R':
+			if (
+				parse_uint(optarg, &ready_fd) == -1
+				|| ready_fd > INT_MAX
+				|| fcntl((int) ready_fd, F_GETFD) == -1
+			) {
+				fprintf(stderr, "%s: invalid ready fd: %s\n", argv[0], optarg);
+				return -1;
+			}
+			ready_adopt((int) ready_fd);
+			break;
+		case 's':
+			for (spawn_engine = 0; spawn_engine < N_SPAWN_ENGINES; spawn_engine++) {
+				if (strcmp(optarg, spawn_engine_names[spawn_engine]) == 0) break;
+			}
+			if (spawn_engine == N_SPAWN_ENGINES) {
+				fprintf(stderr, "%s: invalid engine: %s\n", argv[0], optarg);
+				return -1;
+			}
+			break;
+		case 't':
+			if (
+				parse_uint(optarg, &timing_fd) == -1
+				|| timing_fd > INT_MAX
+				|| fcntl((int) timing_fd, F_GETFD) == -1
+			) {
+				fprintf(stderr, "%s: invalid timing fd: %s\n", argv[0], optarg);
+				return -1;
+			}
+			timing_init((int) timing_fd);
+			break;
+		case 'T':
+			trace_path = optarg;
+			break;
+		case 'u':
+			usage_accounting = 1;
+			break;
+		case 'w':
+			for (wait_backend = 0; wait_backend < N_WAIT_BACKENDS; wait_backend++) {
+				if (strcmp(optarg, wait_backend_names[wait_backend]) == 0) break;
+			}
+			if (wait_backend == N_WAIT_BACKENDS) {
+				fprintf(stderr, "%s: invalid backend: %s\n", argv[0], optarg);
+				return -1;
+			}
+			break;
+		case 'z':
+			for (storm_mode = 0; storm_mode < N_STORM_MODES; storm_mode++) {
+				if (strcmp(optarg, storm_mode_names[storm_mode]) == 0) break;
+			}
+			if (storm_mode == N_STORM_MODES) {
+				fprintf(stderr, "%s: invalid storm mode: %s\n", argv[0], optarg);
+				return -1;
+			}
+			break;
+		default:
+			usage(argv[0]);
+			return -1;
+		}
+	}
+	if (optind != argc) exec_argv = argv + optind;
+	group_broadcast = sigpolicy_forwarding();
+
+	// a command at the leaves needs us to reap it, and catch nothing
+	// meant for it
+	if (exec_argv && (
+		thread_mode
+		|| group_broadcast
+		|| rtsig_offset >= 0
+		|| wait_backend != WAIT_CLASSIC
+	)) {
+		fprintf(stderr, "%s: a command cannot be run with -g, -p, -q, -w or a forward action\n", argv[0]);
+		return -1;
+	}
+
+	// an exec leaves no shared memory behind to broadcast through
+	if (group_broadcast && spawn_engine_execs(spawn_engine)) {
+		fprintf(
+			stderr,
+			"%s: -g and forward actions are not supported with the %s engine\n",
+			argv[0],
+			spawn_engine_names[spawn_engine]
+		);
+		return -1;
+	}
+	// threads share one process - there is nothing to exec, broadcast to,
+	// escalate to, reap or account for level by level
+	// only the classic backend hands a failed child back to respawn, and a
+	// standby is a fork of the level that is waiting on it
+	if (max_restarts && (thread_mode || wait_backend != WAIT_CLASSIC)) {
+		fprintf(stderr, "%s: -k cannot be used with -p or -w\n", argv[0]);
+		return -1;
+	}
+	if (keep_standby && (!max_restarts || spawn_engine != SPAWN_FORK)) {
+		fprintf(stderr, "%s: -K needs -k and the fork engine\n", argv[0]);
+		return -1;
+	}
+	if (placement_cpus && placement_numa) {
+		fprintf(stderr, "%s: -a and -N are exclusive\n", argv[0]);
+		return -1;
+	}
+	if (thread_mode && (
+		placement_cpus
+		|| placement_numa
+		|| leaf_priority
+		|| status_board
+		|| drain_deadline_ms
+		|| group_broadcast
+		|| signal_policy
+		|| heap_mb
+		|| footprint_mode
+		|| warm_mode
+		|| stats_mode
+		|| init_mode
+		|| rtsig_offset >= 0
+		|| spawn_engine != SPAWN_FORK
+		|| trace_path
+		|| usage_accounting
+		|| wait_backend != WAIT_CLASSIC
+		|| storm_mode != STORM_OFF
+	)) {
+		fprintf(stderr, "%s: -p takes no options but -d, -f and -t\n", argv[0]);
+		return -1;
+	}
+	if (spawned_level > depth) {
+		fprintf(stderr, "%s: invalid level: %u\n", argv[0], spawned_level);
+		return -1;
+	}
+
+	// total = 1 + fanout + fanout^2 + ... + fanout^(depth-1)
+	unsigned long total = 0, level_width = 1;
+	for (unsigned level = 0; level < depth; level++) {
+		total += level_width;
+		n_leaves = level_width;
+		if (total > MAX_PROCESSES) {
 			fprintf(
 				stderr,
-				"logmsg: sysconf: %s\n",
-				(errno ? strerror(errno) : "indeterminant page size")
+				"%s: tree of depth %u, fanout %u exceeds %lu processes\n",
+				argv[0],
+				depth,
+				fanout,
+				MAX_PROCESSES
 			);
-			return;
+			return -1;
+		}
+		// saturate rather than overflow - total trips the check next round
+		if (level_width > MAX_PROCESSES / fanout) {
+			level_width = MAX_PROCESSES + 1;
+		}
+		else {
+			level_width *= fanout;
 		}
 	}
 
-	const size_t buf_siz = (size_t) sys_page_size;
-	static char *buf = NULL;
-	if (buf == NULL) {
-		if ((buf = malloc(sys_page_size * sizeof(*buf))) == NULL) {
-			perror("logmsg: malloc");
-			return;
+	stack_depth = depth;
+	n_processes = total;
+	fork_id = spawned_level ? spawned_level : depth;
+	return 0;
+}
+
+static
+void
+init_forward_signal (const pid_t *children, unsigned n_children)
+{
+	int signum = forward_signum;
+	if (!signum) return;
+	forward_signum = 0;
+
+	logmsg("forwarding signal %d to children", signum);
+	for (unsigned i = 0; i < n_children; i++) {
+		if (children[i] && kill(children[i], signum) == -1 && errno != ESRCH) {
+			perror("init_forward_signal: kill");
 		}
 	}
-	size_t buf_available = buf_siz;
-	int written = 0;
+}
 
-	// write preamble to buf
-	written = snprintf(
-		buf,
-		buf_available,
-		"fork #%3u (pid %llu):\t",
-		fork_id,
-		(long long unsigned) getpid()
-	);
-	if (written < 0) {
-		perror("logmsg: snprintf");
-		return;
+static
+int
+await_children (pid_t *children, unsigned n_children)
+{
+	if (init_mode && top_of_stack) {
+		// the event loop's mask was inherited by our children - we handle
+		// signals ourselves
+		if (wait_backend == WAIT_EPOLL || wait_backend == WAIT_URING) {
+			sigset_t mask;
+			sigemptyset(&mask);
+			sigpolicy_fill(&mask);
+			sigprocmask(SIG_UNBLOCK, &mask, NULL);
+		}
+		init_forward_signal(children, n_children);
+		return init_reap(
+			children,
+			n_children,
+			init_forward_signal,
+			child_failed,
+			&child_status
+		);
 	}
 
-	// buf_siz should be large enough to fit our preamble in all cases
-	// if it was truncated, consider it a programming error
-	if ((unsigned) written > buf_available) {
-		fprintf(stderr, "logmsg: preamble buffer overflow\n");
-		return;
+	switch (wait_backend) {
+	case WAIT_EPOLL:
+		return evloop_reap(children, n_children, on_signal);
+	case WAIT_URING:
+		return uring_reap(children, n_children, on_signal);
+	case WAIT_PIDFD:
+		if (pidfd_supervise(children, n_children) == 0) return 0;
+		if (errno != ENOSYS) return -1;
+		// kernel predates pidfds - nothing was reaped, so fall back
+		return reap_children(children, n_children);
+	default:
+		return reap_children(children, n_children);
 	}
-	buf_available -= written;
+}
 
-	// write caller's msg to buf (possibly truncated)
-	va_list vargs;
-	va_start(vargs, fmt);
-	written = vsnprintf(
-		buf + buf_siz - buf_available,
-		buf_available,
-		fmt,
-		vargs
-	);
-	if (written < 0) {
-		perror("logmsg: vsnprintf");
+static
+int
+await_signal (void)
+{
+	if (wait_backend == WAIT_EPOLL || wait_backend == WAIT_URING) {
+		// already blocked by main
+		logmsg("last child awaiting signal");
+		board_set(BOARD_AWAITING);
+		trace_event(TRACE_READY, 0, 0);
+		timing_ready();
+		ready_report();
+		if (wait_backend == WAIT_URING) {
+			if (uring_await_signal(on_signal, &fatal_signum) == -1) {
+				perror("await_signal: uring_await_signal");
+				return -1;
+			}
+			return 0;
+		}
+		if (evloop_await_signal(on_signal, &fatal_signum) == -1) {
+			perror("await_signal: evloop_await_signal");
+			return -1;
+		}
+		return 0;
 	}
-	va_end(vargs);
-	if (written < 0) {
-		return;
+
+	// hold SIGINT off until we are actually waiting, so a signal sent the
+	// moment we report ready can't slip in ahead of us and leave us waiting
+	// forever, as pause() would
+	sigset_t wait_mask, orig_mask;
+	sigemptyset(&wait_mask);
+	sigaddset(&wait_mask, SIGINT);
+	if (sigprocmask(SIG_BLOCK, &wait_mask, &orig_mask) == -1) {
+		perror("await_signal: sigprocmask");
+		return -1;
+	}
+	logmsg("last child awaiting signal");
+	board_set(BOARD_AWAITING);
+	trace_event(TRACE_READY, 0, 0);
+	timing_ready();
+	ready_report();
+	// realtime-signal probes and storms wake us too
+	while (!fatal_signum) {
+		sigsuspend(&orig_mask);
+		logmsg_drain();
 	}
+	sigprocmask(SIG_SETMASK, &orig_mask, NULL);
+	logmsg_drain();
+	return 0;
+}
 
-	if ((unsigned) written <= buf_available) {
-		buf_available -= written;
+static
+int
+reap_children (pid_t *children, unsigned n_children)
+{
+	// every child of ours is part of the tree, so reap whichever exits first
+	unsigned remaining = 0;
+	for (unsigned i = 0; i < n_children; i++) {
+		if (children[i]) remaining++;
+	}
+	while (remaining > 0) {
+		// sleep until something exits, without reaping it yet...
+		siginfo_t info;
+		STACK_PROBE2(wait__entry, fork_id, remaining);
+		uint64_t wait_start = stats_wait_begin();
+		int ret = waitid(P_ALL, 0, &info, WEXITED | WNOWAIT);
+		STACK_PROBE2(wait__return, fork_id, ret == -1 ? -1 : info.si_pid);
+		stats_wait_end(wait_start, ret == -1 && errno == EINTR);
+		reap_syscalls(1);
+		if (ret == -1) {
+			// we expect to be interrupted
+			if (errno == EINTR) {
+				STACK_PROBE2(eintr, fork_id, "reap_children");
+				logmsg_drain();
+				continue;
+			}
+			perror("reap_children: waitid");
+			return -1;
+		}
+		reap_woke();
+
+		// ...then reap everything that has exited by now, so that a wide
+		// level unwinding takes a handful of wakeups rather than one a child
+		pid_t pid;
+		while ((pid = usage_wait(&child_status, WNOHANG)) > 0) {
+			reap_syscalls(1);
+			// the standby is not part of the tree until it is woken
+			if (pid == standby_pid) {
+				standby_pid = 0;
+				continue;
+			}
+			long slot = reap_take(pid);
+			if (slot < 0) continue;
+			children[slot] = 0;
+			remaining--;
+			if (child_failed((unsigned) slot, child_status)) return 1;
+		}
+		// and the one that found nothing left
+		reap_syscalls(1);
+		if (pid == -1 && errno != EINTR && errno != ECHILD) {
+			perror("reap_children: wait4");
+			return -1;
+		}
+	}
+	reap_report();
+	return 0;
+}
+
+static
+int
+exec_command (void)
+{
+	// exec(3) puts caught signals back to their defaults, but not the mask,
+	// nor the ones we ignore
+	sigset_t none;
+	sigemptyset(&none);
+	sigprocmask(SIG_SETMASK, &none, NULL);
+	sigpolicy_reset();
+
+	logmsg("exec'ing %s", exec_argv[0]);
+	board_set(BOARD_AWAITING);
+	trace_event(TRACE_READY, 0, 0);
+	timing_ready();
+	ready_report();
+	// our children exec us with these, but the command is not one of us
+	timing_close_on_exec();
+	if (shared_unexport() == -1) perror("exec_command: shared_unexport");
+	execvp(exec_argv[0], exec_argv);
+	perror("exec_command: execvp");
+	// on_exit is for the stack, and this is as good as the command's exit
+	_exit(127);
+}
+
+static
+void
+become_child (int ready_fds[2])
+{
+	// the init's signal handling stops with the init
+	if (top_of_stack && init_mode && !exec_argv) {
+		if (sigpolicy_install(on_signal, 0, 1) == -1) perror("become_child: sigpolicy_install");
+	}
+	top_of_stack = 0;
+	fork_id--;
+	logmsg_init();
+	if (placement_apply() == -1) perror("become_child: placement_apply");
+	heap_touch();
+	board_claim();
+	trace_claim();
+	stats_claim(0);
+	// our parent's children are our siblings - not ours to escalate to, nor
+	// to forward to - and its restarts and standby are its own. Whatever
+	// still points at them lets go first. A leaf never has children, so it
+	// drops them rather than fault in the pages to clear them, on the way to
+	// reporting ready
+	rtsig_watch(NULL, 0);
+	drain_reset();
+	if (fork_id > 1) {
+		memset(children, 0, fanout * sizeof(*children));
+		reap_reset();
 	}
 	else {
-		buf_available = 0;
+		children = NULL;
 	}
+	n_restarts = 0;
+	n_unready = 0;
+	failed_ns = 0;
+	standby_pid = 0;
+	if (standby_wake_fd >= 0) close(standby_wake_fd);
+	if (standby_ready_fd >= 0) close(standby_ready_fd);
+	standby_wake_fd = standby_ready_fd = -1;
+	close(ready_fds[0]);
+	ready_adopt(ready_fds[1]);
+	logmsg("started");
+	// our memory locks stayed with our parent
+	if (warm_mode && warm_apply() == -1) perror("become_child: warm_apply");
+}
 
-	// write linebreak, terminator to buf (always)
-	if (buf_available < 2) buf_available = 2;
-	buf[buf_siz-buf_available--] = '\n';
-	buf[buf_siz-buf_available--] = '\0';
+static
+int
+child_failed (unsigned slot, int status)
+{
+	// -k: a child that failed before we were told to unwind gets respawned in
+	// its slot
+	int failed = WIFSIGNALED(status) || (WIFEXITED(status) && WEXITSTATUS(status) != 0);
+	if (!max_restarts || fatal_signum || !failed) return 0;
+	failed_slot = slot;
+	// a respawn that failed in turn is still recovering from the first
+	if (!failed_ns) failed_ns = timing_now();
+	return 1;
+}
 
-	// write buf to stderr
-	if (fputs(buf, stderr) == EOF) {
-		perror("logmsg: fputs");
-		return;
+static
+pid_t
+respawn_child (pid_t *children)
+{
+	if (n_restarts >= max_restarts) {
+		logmsg("child failed, out of restarts after %u", n_restarts);
+		return -1;
+	}
+
+	// back off, doubling each time, in case whatever killed the last one is
+	// still about - unless we are told to unwind in the meantime
+	unsigned backoff_ms = restart_backoff_ms;
+	for (unsigned i = 0; i < n_restarts && backoff_ms < restart_backoff_max_ms; i++) {
+		backoff_ms *= 2;
+	}
+	if (backoff_ms > restart_backoff_max_ms) backoff_ms = restart_backoff_max_ms;
+	struct timespec backoff = {
+		.tv_sec = backoff_ms / 1000,
+		.tv_nsec = (long) (backoff_ms % 1000) * 1000000L,
+	};
+	while (nanosleep(&backoff, &backoff) == -1 && errno == EINTR) {
+		logmsg_drain();
+		if (fatal_signum) return -1;
+	}
+	n_restarts++;
+
+	// the standby is already forked - it only needs waking
+	pid_t pid;
+	int ready_fd;
+	if (standby_pid) {
+		pid = standby_pid;
+		ready_fd = standby_ready_fd;
+		if (write(standby_wake_fd, "", 1) == -1) perror("respawn_child: write");
+		close(standby_wake_fd);
+		standby_pid = 0;
+		standby_wake_fd = standby_ready_fd = -1;
+	}
+	else {
+		int ready_fds[2];
+		if (ready_open(ready_fds) == -1) {
+			perror("respawn_child: ready_open");
+			return -1;
+		}
+		if ((pid = spawn_child(fork_id - 1, ready_fds[1])) == 0) {
+			become_child(ready_fds);
+			return 0;
+		}
+		close(ready_fds[1]);
+		if (pid == -1) {
+			perror("respawn_child: spawn_child");
+			close(ready_fds[0]);
+			return -1;
+		}
+		ready_fd = ready_fds[0];
+	}
+	children[failed_slot] = pid;
+	reap_add(pid, failed_slot);
+	trace_event(TRACE_SPAWNED, 0, pid);
+	STACK_PROBE2(spawn, fork_id, pid);
+
+	// recovered once the new subtree is back up - one gone before then is
+	// another failure, left for await_children() to reap
+	int ready = ready_await(ready_fd, 1, NULL);
+	if (ready == -1) perror("respawn_child: ready_await");
+	if (ready != 1) {
+		logmsg("respawned child %ld exited before it was ready", (long) pid);
+		return pid;
 	}
+	uint64_t recover_ns = timing_now() - failed_ns;
+	failed_ns = 0;
+	logmsg(
+		"respawned child %ld, restart %u of %u, recovered in %llu us",
+		(long) pid,
+		n_restarts,
+		max_restarts,
+		(long long unsigned) (recover_ns / 1000)
+	);
+	timing_respawn(n_restarts, recover_ns);
+	// the tree never came up whole before - it has now, if this was the
+	// last child missing
+	if (n_unready > 0 && --n_unready == 0) ready_report();
+
+	if (keep_standby && n_restarts < max_restarts && fork_standby() == 0) return 0;
+	return pid;
+}
+
+static
+pid_t
+fork_standby (void)
+{
+	int wake_fds[2], ready_fds[2];
+	if (pipe(wake_fds) == -1) {
+		perror("fork_standby: pipe");
+		return -1;
+	}
+	if (ready_open(ready_fds) == -1) {
+		perror("fork_standby: ready_open");
+		close(wake_fds[0]);
+		close(wake_fds[1]);
+		return -1;
+	}
+
+	// parked with every signal held off - it is not part of the tree until
+	// it is woken, and exits without a word if we go first
+	sigset_t all, orig_mask;
+	sigfillset(&all);
+	sigprocmask(SIG_BLOCK, &all, &orig_mask);
+	pid_t pid = fork();
+	if (pid != 0) {
+		sigprocmask(SIG_SETMASK, &orig_mask, NULL);
+		close(wake_fds[0]);
+		close(ready_fds[1]);
+		if (pid == -1) {
+			perror("fork_standby: fork");
+			close(wake_fds[1]);
+			close(ready_fds[0]);
+			return -1;
+		}
+		standby_pid = pid;
+		standby_wake_fd = wake_fds[1];
+		standby_ready_fd = ready_fds[0];
+		logmsg("standby %ld parked", (long) pid);
+		return pid;
+	}
+
+	close(wake_fds[1]);
+	char byte;
+	ssize_t n;
+	while ((n = read(wake_fds[0], &byte, 1)) == -1 && errno == EINTR) {}
+	if (n != 1) _exit(EXIT_SUCCESS);
+	close(wake_fds[0]);
+	sigprocmask(SIG_SETMASK, &orig_mask, NULL);
+	become_child(ready_fds);
+	return 0;
+}
+
+static
+void
+drop_standby (void)
+{
+	// it exits once it sees the pipe close
+	if (!standby_pid) return;
+	close(standby_wake_fd);
+	close(standby_ready_fd);
+	while (waitpid(standby_pid, NULL, 0) == -1 && errno == EINTR) {}
+	standby_pid = 0;
+	standby_wake_fd = standby_ready_fd = -1;
+}
+
+static
+void
+exit_as_child (void)
+{
+	// a command that handled our signal and exited cleanly has the last word
+	if (WIFSIGNALED(child_status)) {
+		fatal_signum = WTERMSIG(child_status);
+		exit(EXIT_FAILURE);
+	}
+	fatal_signum = 0;
+	exit(WIFEXITED(child_status) ? WEXITSTATUS(child_status) : EXIT_FAILURE);
 }
 
 static
@@ -209,17 +1395,49 @@ void
 on_exit (void)
 {
 	int signum = fatal_signum;
+	timing_mark(TIMING_EXIT);
+	stats_exit();
 	logmsg("exiting");
+	board_set(BOARD_EXITING);
+	trace_event(TRACE_EXIT, signum, 0);
+	timing_report();
+	rtsig_report();
+	storm_report();
+	drain_report();
+	usage_exit();
+	if (footprint_mode && footprint_report() == -1) perror("on_exit: footprint_report");
 
 	if (!signum) return;
-	if (signal(signum, SIG_DFL) == SIG_ERR) {
+
+	// the kernel drops default-fatal signals sent to pid 1 - even our own -
+	// so exit the way we would have died instead
+	if (init_mode && top_of_stack && getpid() == 1) {
+		logmsg("pid 1 cannot re-raise, exiting with status %d", 128 + signum);
+		_exit(128 + signum);
+	}
+
+	// SIGKILL and SIGSTOP cannot be caught, so have no handler to reset -
+	// the command killed by the drain escalation passes one up
+	if (signum != SIGKILL && signum != SIGSTOP && signal(signum, SIG_DFL) == SIG_ERR) {
 		perror("on_exit: signal");
 		_exit(EXIT_FAILURE);
 	}
-	if (raise(signum)) {
+	// the event loop keeps its signals blocked - let this one through
+	sigset_t reraise_mask;
+	sigemptyset(&reraise_mask);
+	sigaddset(&reraise_mask, signum);
+	sigprocmask(SIG_UNBLOCK, &reraise_mask, NULL);
+	trace_event(TRACE_RERAISE, signum, 0);
+	STACK_PROBE2(reraise, fork_id, signum);
+	stats_reraised();
+	// raise(3) signals our thread by its cached tid, which is our parent's
+	// after a bare clone3(2) - we are single-threaded, so aim at the process
+	if (kill(getpid(), signum)) {
 		perror("on_exit: kill");
 	}
 	logmsg("did not die after reraise! calling _exit(3)");
+	STACK_PROBE2(exit__fallback, fork_id, signum);
+	stats_fell_back();
 	_exit(EXIT_FAILURE);
 }
 
@@ -227,6 +1445,41 @@ static
 void
 on_signal (int signum)
 {
+	// only async-signal-safe calls from here - formatting and writing the
+	// record is left to logmsg_drain()
+	int saved_errno = errno;
+	STACK_PROBE2(signal, fork_id, signum);
+	stats_signal(signum);
+
+	// the event loop passes storm signals here too
+	if (storm_is(signum)) {
+		storm_count(signum);
+		errno = saved_errno;
+		return;
+	}
+
+	// whoever broadcasts gets their own signal back - once is enough
+	if (group_broadcast && fatal_signum) {
+		errno = saved_errno;
+		return;
+	}
+
+	timing_mark(TIMING_SIGNAL);
+	storm_stop();
 	fatal_signum = signum;
-	logmsg("caught signal");
+	board_signal(signum);
+	trace_event(TRACE_SIGNAL, signum, 0);
+	if (drain_deadline_ms) drain_start();
+	if (init_mode && top_of_stack) forward_signum = signum;
+	// wrapping a command, nothing else is going to pass the signal on
+	else if (exec_argv) {
+		for (unsigned i = 0; children && i < fanout; i++) {
+			if (children[i]) kill(children[i], signum);
+		}
+	}
+	logmsg_async("caught signal");
+	if (sigpolicy_forwards(signum) && broadcast_signal(signum) == 1) {
+		logmsg_async("broadcast signal to process group");
+	}
+	errno = saved_errno;
 }
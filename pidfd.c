@@ -0,0 +1,150 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif /* #ifndef _GNU_SOURCE */
+#endif /* #ifdef __linux__ */
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
+#endif /* #ifndef _XOPEN_SOURCE */
+
+#include <errno.h>      // for errno itself
+#include <poll.h>       // for poll(2)
+#include <stdint.h>     // for uint64_t
+#include <stdio.h>      // for perror(3)
+#include <stdlib.h>     // for calloc(3)
+#include <sys/resource.h> // for struct rusage
+#include <sys/wait.h>   // for waitid(2)
+#include <unistd.h>     // for close(2), syscall(2)
+
+#ifdef __linux__
+#include <sys/syscall.h> // for SYS_pidfd_open, SYS_waitid
+#endif /* #ifdef __linux__ */
+
+#include "log.h"
+#include "pidfd.h"
+#include "reap.h"
+#include "stack.h"
+#include "stats.h"
+#include "usage.h"
+
+// P_PIDFD is an enumerator in glibc, not a macro, so it can't be tested for
+// use the kernel's value directly
+#define WAITID_P_PIDFD ((idtype_t) 3)
+
+int
+pidfd_open_child (pid_t pid)
+{
+#if defined(__linux__) && defined(SYS_pidfd_open)
+	// call the syscall directly - glibc only wraps it from 2.36
+	return (int) syscall(SYS_pidfd_open, pid, 0U);
+#else
+	(void) pid;
+	errno = ENOSYS;
+	return -1;
+#endif /* #if defined(__linux__) && defined(SYS_pidfd_open) */
+}
+
+int
+pidfd_reap (int pidfd)
+{
+#ifdef __linux__
+	siginfo_t info;
+	struct rusage usage;
+	// the raw syscall takes a fifth argument glibc's waitid(3) hides - the
+	// rusage that wait4(2) would give us
+	while (syscall(SYS_waitid, WAITID_P_PIDFD, pidfd, &info, WEXITED, &usage) == -1) {
+		if (errno != EINTR) return -1;
+	}
+	usage_reaped(fork_id - 1, info.si_code != CLD_EXITED, &usage);
+	return 0;
+#else
+	(void) pidfd;
+	errno = ENOSYS;
+	return -1;
+#endif /* #ifdef __linux__ */
+}
+
+int
+pidfd_supervise (pid_t *children, unsigned n_children)
+{
+	struct pollfd *pfds = calloc(n_children ? n_children : 1U, sizeof(*pfds));
+	if (pfds == NULL) {
+		perror("pidfd_supervise: calloc");
+		return -1;
+	}
+
+	// open every pidfd up front, so ENOSYS leaves the caller free to fall back
+	for (unsigned i = 0; i < n_children; i++) {
+		pfds[i].events = POLLIN;
+		if ((pfds[i].fd = pidfd_open_child(children[i])) == -1) {
+			int saved_errno = errno;
+			if (saved_errno != ENOSYS) perror("pidfd_supervise: pidfd_open");
+			while (i > 0) close(pfds[--i].fd);
+			free(pfds);
+			errno = saved_errno;
+			return -1;
+		}
+	}
+
+	unsigned remaining = n_children;
+	while (remaining > 0) {
+		uint64_t wait_start = stats_wait_begin();
+		int polled = poll(pfds, n_children, -1);
+		stats_wait_end(wait_start, polled == -1 && errno == EINTR);
+		reap_syscalls(1);
+		if (polled == -1) {
+			// poll(2) is never restarted - this is our signal handler
+			if (errno == EINTR) {
+				logmsg_drain();
+				continue;
+			}
+			perror("pidfd_supervise: poll");
+			goto error;
+		}
+		reap_woke();
+		for (unsigned i = 0; i < n_children && polled > 0; i++) {
+			if (!pfds[i].revents) continue;
+			polled--;
+			if (pidfd_reap(pfds[i].fd) == -1) {
+				perror("pidfd_supervise: waitid");
+				goto error;
+			}
+			close(pfds[i].fd);
+			// the waitid(2) and the close(2)
+			reap_syscalls(2);
+			reap_take(children[i]);
+			// poll(2) skips negative fds, so the set never needs rebuilding
+			pfds[i].fd = -1;
+			children[i] = 0;
+			remaining--;
+		}
+	}
+	free(pfds);
+	reap_report();
+	return 0;
+
+error:
+	for (unsigned i = 0; i < n_children; i++) {
+		if (pfds[i].fd >= 0) close(pfds[i].fd);
+	}
+	free(pfds);
+	return -1;
+}
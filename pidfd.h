@@ -0,0 +1,42 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef PIDFD_H
+#define PIDFD_H
+
+#include <sys/types.h>  // for pid_t
+
+// open a file descriptor referring to pid, which becomes readable once it
+// exits
+// returns -1 with errno ENOSYS where the kernel or platform lacks pidfds
+int
+pidfd_open_child (pid_t pid);
+
+// reap the exited child referred to by pidfd, accounting for it in usage.h
+// returns 0, or -1 with errno set
+int
+pidfd_reap (int pidfd);
+
+// reap all n_children children, watching them through one poll(2) set of
+// pidfds and zeroing each as it is reaped. Signal handlers interrupting the
+// poll have their logs drained
+// returns 0, or -1 with errno set - ENOSYS, before anything is reaped, where
+// pidfds are unavailable
+int
+pidfd_supervise (pid_t *children, unsigned n_children);
+
+#endif /* #ifndef PIDFD_H */
@@ -0,0 +1,204 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif /* #ifndef _GNU_SOURCE */
+#endif /* #ifdef __linux__ */
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
+#endif /* #ifndef _XOPEN_SOURCE */
+
+#include <errno.h>      // for errno itself
+#include <stdio.h>      // for fopen(3), fgets(3), snprintf(3)
+#include <stdlib.h>     // for strtoul(3)
+#include <string.h>     // for strchr(3), strcspn(3), strlen(3)
+
+#ifdef __linux__
+#include <sched.h>      // for sched_setaffinity(2), sched_setscheduler(2)
+#endif /* #ifdef __linux__ */
+
+#include "log.h"
+#include "placement.h"
+#include "stack.h"
+
+// longest CPU list we keep, as given or as sysfs has it
+#define CPULIST_MAX 256U
+
+#ifdef __linux__
+
+struct placement {
+	cpu_set_t cpus;
+	char list[CPULIST_MAX];
+};
+
+static
+struct placement
+placements[MAX_PLACEMENTS];
+
+static
+unsigned
+n_placements = 0;
+
+static
+unsigned
+stack_depth = 0;
+
+static
+unsigned
+rt_priority = 0;
+
+// -N: placements are NUMA nodes, used round-robin
+static
+int
+spread_levels = 0;
+
+static
+int
+parse_cpulist (const char *list, size_t len, struct placement *out);
+
+static
+int
+read_numa_nodes (void);
+
+#endif /* #ifdef __linux__ */
+
+int
+placement_init (unsigned depth, const char *cpus, int spread_numa, unsigned leaf_priority)
+{
+#ifdef __linux__
+	stack_depth = depth;
+	rt_priority = leaf_priority;
+	spread_levels = spread_numa;
+	if (spread_numa) return read_numa_nodes();
+
+	while (cpus && *cpus) {
+		size_t len = strcspn(cpus, "/");
+		if (n_placements == MAX_PLACEMENTS) {
+			errno = E2BIG;
+			return -1;
+		}
+		if (parse_cpulist(cpus, len, &placements[n_placements]) == -1) return -1;
+		n_placements++;
+		cpus += len;
+		if (*cpus == '/') cpus++;
+	}
+	return 0;
+#else
+	(void) depth;
+	if (cpus || spread_numa || leaf_priority) {
+		errno = ENOSYS;
+		return -1;
+	}
+	return 0;
+#endif /* #ifdef __linux__ */
+}
+
+int
+placement_apply (void)
+{
+#ifdef __linux__
+	if (n_placements) {
+		// levels from the top - the nodes wrap around, the CPU lists stop
+		unsigned level = stack_depth - fork_id;
+		const struct placement *place = &placements[
+			spread_levels
+			? level % n_placements
+			: (level < n_placements ? level : n_placements - 1)
+		];
+		if (sched_setaffinity(0, sizeof(place->cpus), &place->cpus) == -1) return -1;
+		logmsg("running on cpus %s", place->list);
+	}
+	if (rt_priority && fork_id == 1) {
+		struct sched_param param = { .sched_priority = (int) rt_priority };
+		if (sched_setscheduler(0, SCHED_FIFO, &param) == -1) return -1;
+		logmsg("running SCHED_FIFO at priority %u", rt_priority);
+	}
+	return 0;
+#else
+	return 0;
+#endif /* #ifdef __linux__ */
+}
+
+#ifdef __linux__
+
+static
+int
+parse_cpulist (const char *list, size_t len, struct placement *out)
+{
+	// the kernel's own format: comma-separated CPUs and ranges, as in 0-3,8
+	if (len == 0 || len >= sizeof(out->list)) {
+		errno = EINVAL;
+		return -1;
+	}
+	memcpy(out->list, list, len);
+	out->list[len] = '\0';
+	CPU_ZERO(&out->cpus);
+
+	const char *cur = out->list;
+	while (*cur) {
+		char *end = NULL;
+		unsigned long first = strtoul(cur, &end, 10), last = first;
+		if (end == cur) break;
+		if (*end == '-') {
+			cur = end + 1;
+			last = strtoul(cur, &end, 10);
+			if (end == cur) break;
+		}
+		if (first > last || last >= CPU_SETSIZE) break;
+		for (unsigned long cpu = first; cpu <= last; cpu++) CPU_SET(cpu, &out->cpus);
+		cur = end;
+		if (*cur == ',') cur++;
+		else if (*cur != '\0') break;
+	}
+	if (*cur != '\0' || CPU_COUNT(&out->cpus) == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	return 0;
+}
+
+static
+int
+read_numa_nodes (void)
+{
+	// node numbers may have gaps - take whichever exist, in order
+	for (unsigned node = 0; node < MAX_PLACEMENTS * 4U; node++) {
+		char path[64];
+		snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", node);
+		FILE *file = fopen(path, "r");
+		if (file == NULL) continue;
+
+		char list[CPULIST_MAX];
+		char *read = fgets(list, sizeof(list), file);
+		fclose(file);
+		if (read == NULL) continue;
+		list[strcspn(list, "\n")] = '\0';
+		// memory-only nodes have no CPUs to run on
+		if (parse_cpulist(list, strlen(list), &placements[n_placements]) == -1) continue;
+		if (++n_placements == MAX_PLACEMENTS) break;
+	}
+	if (n_placements == 0) {
+		errno = ENOENT;
+		return -1;
+	}
+	return 0;
+}
+
+#endif /* #ifdef __linux__ */
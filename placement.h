@@ -0,0 +1,44 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+// where each level of the stack runs: pinned to a CPU set of its own, or
+// spread across NUMA nodes level by level, and the leaves optionally in a
+// realtime scheduling class - since signal delivery and wakeups between
+// levels cost more the further apart they run
+
+// deepest stack -a can give CPU sets of their own, and most NUMA nodes -N
+// spreads across
+#define MAX_PLACEMENTS 64U
+
+// -a, -N and -r: pin the levels of a stack depth levels deep, from the top,
+// to the CPU lists in cpus - '/'-separated, the last for every level beyond -
+// or if spread_numa is set, to the CPUs of one NUMA node after another; and
+// run the leaves SCHED_FIFO at leaf_priority, if it is nonzero
+// returns 0, or -1 with errno set
+int
+placement_init (unsigned depth, const char *cpus, int spread_numa, unsigned leaf_priority);
+
+// place this process as its level calls for - at startup, and again after
+// every fork
+// returns 0, or -1 with errno set
+int
+placement_apply (void);
+
+#endif /* #ifndef PLACEMENT_H */
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef PROBES_H
+#define PROBES_H
+
+// USDT probes, for bpftrace, perf and SystemTap, at the points a signal
+// travels through the stack - provider signal_process_stack:
+//
+// spawn(level, child pid)
+// wait__entry(level, children left), wait__return(level, pid reaped)
+// eintr(level, function retrying)
+// signal(level, signum)               - on entry to the handler
+// reraise(level, signum)
+// exit__fallback(level, signum)       - the re-raise did not kill us
+//
+// built in wherever <sys/sdt.h>, from systemtap-sdt-dev, is installed - or
+// forced with CPPFLAGS=-DSTACK_USDT, and left out with -DSTACK_NO_USDT. Each
+// is a single nop until a tracer attaches, so they stay in production builds
+// - without them the probes compile to nothing, and their arguments are never
+// evaluated
+
+// nested, as a preprocessor without __has_include cannot parse its use
+#if !defined(STACK_USDT) && !defined(STACK_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define STACK_USDT
+#endif /* #if __has_include(<sys/sdt.h>) */
+#endif /* #if !defined(STACK_USDT) && !defined(STACK_NO_USDT) && defined(__has_include) */
+
+#if defined(STACK_USDT) && !defined(STACK_NO_USDT)
+
+#include <sys/sdt.h>    // for DTRACE_PROBE2(3)
+
+#define STACK_PROBE2(name, a, b) DTRACE_PROBE2(signal_process_stack, name, a, b)
+
+#else
+
+#define STACK_PROBE2(name, a, b) ((void) sizeof(a), (void) sizeof(b))
+
+#endif /* #if defined(STACK_USDT) && !defined(STACK_NO_USDT) */
+
+#endif /* #ifndef PROBES_H */
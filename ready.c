@@ -0,0 +1,155 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
+#endif /* #ifndef _XOPEN_SOURCE */
+
+#include <errno.h>      // for errno itself
+#include <fcntl.h>      // for fcntl(2)
+#include <stddef.h>     // for offsetof
+#include <stdio.h>      // for perror(3)
+#include <stdlib.h>     // for getenv(3)
+#include <string.h>     // for strlen(3), memcpy(3)
+#include <sys/socket.h> // for sendto(2), socket(2)
+#include <sys/un.h>     // for struct sockaddr_un
+#include <unistd.h>     // for close(2), pipe(2), read(2), write(2)
+
+#include "log.h"
+#include "ready.h"
+#include "timing.h"
+
+// where we report our subtree being ready - -1 at the top of the stack
+static
+int
+report_fd = -1;
+
+static
+uint64_t
+started_ns = 0;
+
+// tell the service manager listening on $NOTIFY_SOCKET, if any, that we are
+// up - the same datagram sd_notify(3) would send
+static
+void
+notify_ready (void);
+
+void
+ready_init (uint64_t started)
+{
+	started_ns = started;
+}
+
+int
+ready_open (int fds[2])
+{
+	if (pipe(fds) == -1) return -1;
+	if (fcntl(fds[0], F_SETFD, FD_CLOEXEC) == -1) {
+		close(fds[0]);
+		close(fds[1]);
+		return -1;
+	}
+	return 0;
+}
+
+void
+ready_adopt (int fd)
+{
+	if (report_fd >= 0) close(report_fd);
+	report_fd = fd;
+	// our own children get a pipe of their own
+	fcntl(report_fd, F_SETFD, FD_CLOEXEC);
+}
+
+int
+ready_await (int fd, unsigned n_children, unsigned *n_missing)
+{
+	int res = 1;
+	while (n_children > 0) {
+		char reports[64];
+		size_t want = n_children < sizeof(reports) ? n_children : sizeof(reports);
+		ssize_t n_read = read(fd, reports, want);
+		if (n_read == -1) {
+			if (errno == EINTR) {
+				logmsg_drain();
+				continue;
+			}
+			res = -1;
+			break;
+		}
+		if (n_read == 0) {
+			// every child has closed its end - some never reported
+			res = 0;
+			break;
+		}
+		n_children -= (unsigned) n_read;
+	}
+	close(fd);
+	if (n_missing) *n_missing = n_children;
+	return res;
+}
+
+void
+ready_report (void)
+{
+	if (report_fd >= 0) {
+		while (write(report_fd, "", 1) == -1 && errno == EINTR) {
+			continue;
+		}
+		close(report_fd);
+		report_fd = -1;
+		return;
+	}
+
+	timing_stack_ready(timing_now() - started_ns);
+	notify_ready();
+}
+
+static
+void
+notify_ready (void)
+{
+	const char *path = getenv("NOTIFY_SOCKET");
+	if (path == NULL || *path == '\0') return;
+
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	size_t path_len = strlen(path);
+	if (path_len >= sizeof(addr.sun_path)) return;
+	memcpy(addr.sun_path, path, path_len);
+	// a leading @ names a socket in Linux's abstract namespace
+	if (addr.sun_path[0] == '@') addr.sun_path[0] = '\0';
+
+	int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+	if (fd == -1) {
+		perror("notify_ready: socket");
+		return;
+	}
+	static const char msg[] = "READY=1";
+	socklen_t addr_len = (socklen_t) (
+		offsetof(struct sockaddr_un, sun_path) + path_len
+	);
+	ssize_t sent = sendto(
+		fd,
+		msg,
+		sizeof(msg) - 1U,
+		0,
+		(struct sockaddr *) &addr,
+		addr_len
+	);
+	if (sent == -1) perror("notify_ready: sendto");
+	close(fd);
+}
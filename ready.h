@@ -0,0 +1,53 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef READY_H
+#define READY_H
+
+#include <stdint.h>     // for uint64_t
+
+// the readiness barrier: each interior level hands its children the write
+// end of a pipe, and waits for a byte from every one of them before
+// reporting up its own - so the top of the stack hears once the whole tree
+// is up, and tells the timing records and any sd_notify(3) listener
+
+// note when the top of the stack started, to measure time-to-ready from
+void
+ready_init (uint64_t started);
+
+// open the pipe our children report to, its read end close-on-exec
+// returns 0, or -1 with errno set
+int
+ready_open (int fds[2]);
+
+// from now on, report to fd - closing whatever we were to report to before,
+// as that pipe belongs to our grandparent
+void
+ready_adopt (int fd);
+
+// wait for n_children reports on fd, then close it, storing how many never
+// came in in *n_missing, if it is not NULL
+// returns 1 once all have reported, 0 if a child exited before reporting, -1
+// with errno set on failure
+int
+ready_await (int fd, unsigned n_children, unsigned *n_missing);
+
+// report that we and everything beneath us are up
+void
+ready_report (void);
+
+#endif /* #ifndef READY_H */
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <errno.h>      // for errno itself
+#include <stdint.h>     // for uint64_t
+#include <stdlib.h>     // for calloc(3)
+#include <string.h>     // for memset(3)
+
+#include "log.h"
+#include "reap.h"
+#include "stats.h"
+#include "timing.h"
+
+// the most entries the minimal build has room for - twice a fanout as wide
+// as the largest tree, rounded up
+#define TABLE_MAX 131072U
+
+struct entry {
+	pid_t pid;          // 0 for an empty entry
+	unsigned slot;
+};
+
+#ifdef STACK_MINIMAL
+static
+struct entry
+table_storage[TABLE_MAX];
+#endif /* #ifdef STACK_MINIMAL */
+
+// a power of two, at least twice as large as the children it holds
+static
+struct entry *
+table = NULL;
+
+static
+size_t
+table_mask = 0;
+
+static
+unsigned long
+n_reaped = 0, n_wakeups = 0, n_syscalls = 0;
+
+static
+uint64_t
+first_reap_ns = 0, last_reap_ns = 0;
+
+static
+size_t
+hash (pid_t pid);
+
+int
+reap_init (unsigned capacity)
+{
+	size_t size = 1;
+	while (size < (size_t) capacity * 2U) size <<= 1;
+#ifdef STACK_MINIMAL
+	if (size > TABLE_MAX) {
+		errno = ENOMEM;
+		return -1;
+	}
+	table = table_storage;
+#else
+	if ((table = calloc(size, sizeof(*table))) == NULL) return -1;
+#endif /* #ifdef STACK_MINIMAL */
+	table_mask = size - 1;
+	return 0;
+}
+
+void
+reap_reset (void)
+{
+	if (table) memset(table, 0, (table_mask + 1) * sizeof(*table));
+	n_reaped = n_wakeups = n_syscalls = 0;
+	first_reap_ns = last_reap_ns = 0;
+}
+
+void
+reap_add (pid_t pid, unsigned slot)
+{
+	if (table == NULL) return;
+	size_t i = hash(pid);
+	while (table[i].pid && table[i].pid != pid) i = (i + 1) & table_mask;
+	table[i].pid = pid;
+	table[i].slot = slot;
+}
+
+long
+reap_take (pid_t pid)
+{
+	stats_reaped(pid);
+	if (table == NULL) return -1;
+	size_t i = hash(pid);
+	while (table[i].pid != pid) {
+		if (table[i].pid == 0) return -1;
+		i = (i + 1) & table_mask;
+	}
+	long slot = (long) table[i].slot;
+
+	// shift back whatever probed past this entry, so no lookup stops short
+	// at the hole - no tombstones to pile up as thousands are reaped
+	size_t hole = i;
+	for (size_t j = (i + 1) & table_mask; table[j].pid; j = (j + 1) & table_mask) {
+		size_t home = hash(table[j].pid);
+		// j stays put if its home lies cyclically in (hole, j]
+		if (((j - home) & table_mask) < ((j - hole) & table_mask)) continue;
+		table[hole] = table[j];
+		hole = j;
+	}
+	table[hole].pid = 0;
+
+	uint64_t now = timing_now();
+	if (n_reaped++ == 0) first_reap_ns = now;
+	last_reap_ns = now;
+	return slot;
+}
+
+void
+reap_woke (void)
+{
+	n_wakeups++;
+}
+
+void
+reap_syscalls (unsigned long n)
+{
+	n_syscalls += n;
+}
+
+void
+reap_report (void)
+{
+	if (n_reaped == 0) return;
+
+	uint64_t ns = last_reap_ns - first_reap_ns;
+	logmsg(
+		"reaped %lu children in %lu wakeups and %lu syscalls over %llu us (%.0f/s)",
+		n_reaped,
+		n_wakeups,
+		n_syscalls,
+		(long long unsigned) (ns / 1000),
+		ns ? n_reaped * 1e9 / (double) ns : 0.0
+	);
+	timing_reap(n_reaped, n_wakeups, n_syscalls, ns);
+}
+
+static
+size_t
+hash (pid_t pid)
+{
+	// pids are handed out mostly in sequence - spread them out
+	return ((size_t) pid * 2654435761U) & table_mask;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef REAP_H
+#define REAP_H
+
+#include <sys/types.h>  // for pid_t
+
+// the children a level reaps, by pid: an open-addressed table, so that
+// finding which of thousands of children exited is one probe rather than a
+// scan of them all - and how fast they were reaped, wakeup by wakeup
+
+// make room for capacity children
+// returns 0, or -1 with errno set
+int
+reap_init (unsigned capacity);
+
+// forget every child and figure - they were our parent's
+void
+reap_reset (void);
+
+// track pid, our child in slot
+void
+reap_add (pid_t pid, unsigned slot);
+
+// stop tracking pid, now reaped, and count it - along with ending the wait
+// it died in, if it did, in the live counters
+// returns its slot, or -1 if it was not our child
+long
+reap_take (pid_t pid);
+
+// count a wakeup with something to reap
+void
+reap_woke (void);
+
+// count n system calls made waiting on, or reaping, children
+void
+reap_syscalls (unsigned long n);
+
+// log and report how many children were reaped, over how many wakeups and
+// system calls, and their rate
+void
+reap_report (void);
+
+#endif /* #ifndef REAP_H */
@@ -0,0 +1,185 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
+#endif /* #ifndef _XOPEN_SOURCE */
+
+#include <errno.h>      // for errno itself
+#include <signal.h>     // for sigaction(2), sigqueue(3)
+#include <stdint.h>     // for uint32_t, uint64_t
+#include <stdio.h>      // for snprintf(3)
+
+#include "log.h"
+#include "rtsig.h"
+#include "timing.h"
+
+// HDR-style buckets: every power of two is split into 2^SUB_BUCKET_BITS
+// linear sub-buckets, so a latency is never off by more than 25% - across
+// the whole 32-bit range of the payload, about 4.3 seconds
+#define SUB_BUCKET_BITS 2U
+#define SUB_BUCKETS (1U << SUB_BUCKET_BITS)
+#define N_BUCKETS ((32U - SUB_BUCKET_BITS + 1U) << SUB_BUCKET_BITS)
+
+static
+int
+rtsig_signum = 0;
+
+static const pid_t *
+rtsig_children = NULL;
+
+static
+unsigned
+rtsig_n_children = 0;
+
+// written from on_probe, read back in normal context by rtsig_report()
+static volatile
+unsigned long
+histogram[N_BUCKETS];
+
+// probes sent some other way than sigqueue(3), so without a timestamp
+static volatile
+unsigned long
+n_unstamped = 0;
+
+static
+unsigned
+bucket_of (uint32_t ns);
+
+static
+uint64_t
+bucket_floor (unsigned bucket);
+
+static
+void
+on_probe (int signum, siginfo_t *info, void *context);
+
+int
+rtsig_init (unsigned offset)
+{
+	if (offset > (unsigned) (SIGRTMAX - SIGRTMIN)) {
+		errno = EINVAL;
+		return -1;
+	}
+	rtsig_signum = SIGRTMIN + (int) offset;
+
+	// restart whatever a probe interrupts - it is not a reason to wake up
+	struct sigaction action = {
+		.sa_sigaction = on_probe,
+		.sa_flags = SA_SIGINFO | SA_RESTART,
+	};
+	sigemptyset(&action.sa_mask);
+	return sigaction(rtsig_signum, &action, NULL);
+}
+
+void
+rtsig_watch (const pid_t *children, unsigned n_children)
+{
+	rtsig_children = children;
+	rtsig_n_children = n_children;
+}
+
+int
+rtsig_send (pid_t pid)
+{
+	union sigval value = { .sival_int = (int) (uint32_t) timing_now() };
+	return sigqueue(pid, rtsig_signum, value);
+}
+
+void
+rtsig_report (void)
+{
+	if (!rtsig_signum) return;
+
+	// nothing may change the histogram while we read it
+	sigset_t mask;
+	sigemptyset(&mask);
+	sigaddset(&mask, rtsig_signum);
+	sigprocmask(SIG_BLOCK, &mask, NULL);
+
+	unsigned long n_probes = 0;
+	char buckets[2048];
+	int len = 0;
+	for (unsigned i = 0; i < N_BUCKETS; i++) {
+		if (!histogram[i]) continue;
+		n_probes += histogram[i];
+		if (len < (int) sizeof(buckets)) {
+			len += snprintf(
+				buckets + len,
+				sizeof(buckets) - (size_t) len,
+				" %llu:%lu",
+				(long long unsigned) bucket_floor(i),
+				histogram[i]
+			);
+		}
+	}
+	if (len >= (int) sizeof(buckets)) len = (int) sizeof(buckets) - 1;
+	buckets[len] = '\0';
+
+	if (!n_probes && !n_unstamped) return;
+	logmsg(
+		"caught %lu probes (%lu unstamped), latency ns floor:count%s",
+		n_probes,
+		n_unstamped,
+		buckets
+	);
+	timing_probes(n_probes, n_unstamped, buckets);
+}
+
+static
+unsigned
+bucket_of (uint32_t ns)
+{
+	unsigned msb = 0;
+	for (uint32_t rest = ns >> 1; rest; rest >>= 1) msb++;
+	if (msb < SUB_BUCKET_BITS) return ns;
+	unsigned shift = msb - SUB_BUCKET_BITS;
+	return ((shift + 1U) << SUB_BUCKET_BITS) + ((ns >> shift) & (SUB_BUCKETS - 1U));
+}
+
+static
+uint64_t
+bucket_floor (unsigned bucket)
+{
+	if (bucket < SUB_BUCKETS) return bucket;
+	unsigned shift = (bucket >> SUB_BUCKET_BITS) - 1U;
+	return (uint64_t) (SUB_BUCKETS + (bucket & (SUB_BUCKETS - 1U))) << shift;
+}
+
+static
+void
+on_probe (int signum, siginfo_t *info, void *context)
+{
+	// only async-signal-safe calls from here, as in on_signal()
+	(void) signum;
+	(void) context;
+	int saved_errno = errno;
+
+	if (info->si_code == SI_QUEUE) {
+		// the payload wraps every 4.3 seconds, and so does the subtraction
+		uint32_t sent = (uint32_t) info->si_value.sival_int;
+		histogram[bucket_of((uint32_t) timing_now() - sent)]++;
+	}
+	else {
+		n_unstamped++;
+	}
+
+	for (unsigned i = 0; i < rtsig_n_children; i++) {
+		if (rtsig_children[i]) rtsig_send(rtsig_children[i]);
+	}
+	errno = saved_errno;
+}
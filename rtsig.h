@@ -0,0 +1,49 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef RTSIG_H
+#define RTSIG_H
+
+#include <sys/types.h>  // for pid_t
+
+// realtime-signal probes: SIGRTMIN + offset is caught with SA_SIGINFO, so
+// probes queue rather than coalesce, and each carries the low 32 bits of
+// its sender's CLOCK_MONOTONIC time in nanoseconds. The handler records the
+// send-to-handler latency in a fixed-bucket histogram, and interior levels
+// pass every probe on to their children with a fresh timestamp - so each
+// level measures one hop of delivery
+
+// catch probes on SIGRTMIN + offset from now on
+// returns 0, or -1 with errno set - EINVAL if that is past SIGRTMAX
+int
+rtsig_init (unsigned offset);
+
+// pass probes on to the n_children pids in children, skipping zeroes
+void
+rtsig_watch (const pid_t *children, unsigned n_children);
+
+// queue one probe to pid, stamped with the time now
+// returns 0, or -1 with errno set
+// async-signal-safe
+int
+rtsig_send (pid_t pid);
+
+// stop catching probes, and log this process's histogram
+void
+rtsig_report (void);
+
+#endif /* #ifndef RTSIG_H */
@@ -0,0 +1,269 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif /* #ifndef _GNU_SOURCE */
+#endif /* #ifdef __linux__ */
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
+#endif /* #ifndef _XOPEN_SOURCE */
+
+#include <dirent.h>     // for opendir(3), readdir(3)
+#include <errno.h>      // for errno itself
+#include <fcntl.h>      // for open(2)
+#include <limits.h>     // for INT_MAX, PATH_MAX
+#include <stdio.h>      // for snprintf(3)
+#include <stdlib.h>     // for getenv(3), mkstemp(3), setenv(3), strtoul(3), unsetenv(3)
+#include <string.h>     // for strchr(3), strlen(3), strncmp(3), strstr(3)
+#include <sys/mman.h>   // for memfd_create(2), mmap(2)
+#include <sys/stat.h>   // for fstat(2)
+#include <unistd.h>     // for close(2), ftruncate(2), readlink(2), unlink(2)
+
+#include "shared.h"
+
+// environment variables are SIGNAL_STACK_SHARED_<name>=<fd>
+#define SHARED_ENV_PREFIX "SIGNAL_STACK_SHARED_"
+
+// and the files behind them signal_stack_<name>, so that shared_find() can
+// tell them apart
+#define SHARED_FILE_PREFIX "signal_stack_"
+
+extern char **environ;
+
+static
+int
+shared_open (const char *name);
+
+static
+int
+shared_env_name (const char *name, char *buf, size_t size);
+
+void *
+shared_create (const char *name, size_t size)
+{
+	char env_name[64], env_value[16];
+	if (shared_env_name(name, env_name, sizeof(env_name)) == -1) return NULL;
+
+	// deliberately not close-on-exec - the fd is how exec'd children find us
+	int fd = shared_open(name);
+	if (fd == -1) return NULL;
+
+	void *mem = MAP_FAILED;
+	if (ftruncate(fd, (off_t) size) == 0) {
+		mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	snprintf(env_value, sizeof(env_value), "%d", fd);
+	if (mem == MAP_FAILED || setenv(env_name, env_value, 1) == -1) {
+		int saved_errno = errno;
+		if (mem != MAP_FAILED) munmap(mem, size);
+		close(fd);
+		errno = saved_errno;
+		return NULL;
+	}
+	return mem;
+}
+
+void *
+shared_attach (const char *name, size_t *size)
+{
+	char env_name[64];
+	if (shared_env_name(name, env_name, sizeof(env_name)) == -1) return NULL;
+
+	const char *value = getenv(env_name);
+	if (value == NULL) {
+		errno = ENOENT;
+		return NULL;
+	}
+	char *end = NULL;
+	errno = 0;
+	unsigned long fd = strtoul(value, &end, 10);
+	if (errno || end == value || *end != '\0' || fd > INT_MAX) {
+		errno = EBADF;
+		return NULL;
+	}
+
+	struct stat st;
+	if (fstat((int) fd, &st) == -1) return NULL;
+	void *mem = mmap(
+		NULL,
+		(size_t) st.st_size,
+		PROT_READ | PROT_WRITE,
+		MAP_SHARED,
+		(int) fd,
+		0
+	);
+	if (mem == MAP_FAILED) return NULL;
+	*size = (size_t) st.st_size;
+	return mem;
+}
+
+int
+shared_unexport (void)
+{
+	size_t prefix_len = strlen(SHARED_ENV_PREFIX);
+	int res = 0;
+	char **env = environ;
+	while (*env != NULL) {
+		if (strncmp(*env, SHARED_ENV_PREFIX, prefix_len) != 0) {
+			env++;
+			continue;
+		}
+		char env_name[64];
+		const char *eq = strchr(*env, '=');
+		size_t name_len = eq ? (size_t) (eq - *env) : strlen(*env);
+		if (name_len >= sizeof(env_name)) {
+			// not one of ours - shared_env_name() would have refused it
+			env++;
+			continue;
+		}
+		memcpy(env_name, *env, name_len);
+		env_name[name_len] = '\0';
+
+		if (eq != NULL) {
+			char *end = NULL;
+			errno = 0;
+			unsigned long fd = strtoul(eq + 1, &end, 10);
+			int flags;
+			if (
+				!errno && end != eq + 1 && *end == '\0' && fd <= INT_MAX
+				&& (flags = fcntl((int) fd, F_GETFD)) != -1
+				&& fcntl((int) fd, F_SETFD, flags | FD_CLOEXEC) == -1
+			) {
+				res = -1;
+			}
+		}
+		if (unsetenv(env_name) == -1) return -1;
+		// unsetenv(3) shuffles environ under us, so start over
+		env = environ;
+	}
+	return res;
+}
+
+void *
+shared_find (pid_t pid, const char *name, size_t *size)
+{
+	char file_name[64];
+	if (snprintf(
+		file_name,
+		sizeof(file_name),
+		SHARED_FILE_PREFIX "%s",
+		name
+	) >= (int) sizeof(file_name)) {
+		errno = ENAMETOOLONG;
+		return NULL;
+	}
+
+	// the fd our target holds it by is the only way in - look through all
+	// of them for one whose file carries its name
+	char dir_path[64];
+	snprintf(dir_path, sizeof(dir_path), "/proc/%lld/fd", (long long) pid);
+	DIR *dir = opendir(dir_path);
+	if (dir == NULL) return NULL;
+
+	int fd = -1, find_errno = ENOENT;
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL) {
+		char link_path[sizeof(dir_path) + sizeof(entry->d_name) + 1U];
+		char target[PATH_MAX];
+		snprintf(link_path, sizeof(link_path), "%s/%s", dir_path, entry->d_name);
+		ssize_t len = readlink(link_path, target, sizeof(target) - 1U);
+		if (len <= 0) continue;
+		target[len] = '\0';
+
+		// "/memfd:<file name> (deleted)", or "<tmpdir>/<file name>.XXXXXX
+		// (deleted)"
+		const char *found = strstr(target, file_name);
+		if (found == NULL) continue;
+		char after = found[strlen(file_name)];
+		if (after != ' ' && after != '.') continue;
+		if ((fd = open(link_path, O_RDONLY)) == -1) find_errno = errno;
+		break;
+	}
+	closedir(dir);
+	if (fd == -1) {
+		errno = find_errno;
+		return NULL;
+	}
+
+	struct stat st;
+	void *mem = MAP_FAILED;
+	if (fstat(fd, &st) == 0) {
+		mem = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	}
+	int saved_errno = errno;
+	close(fd);
+	if (mem == MAP_FAILED) {
+		errno = saved_errno;
+		return NULL;
+	}
+	*size = (size_t) st.st_size;
+	return mem;
+}
+
+static
+int
+shared_open (const char *name)
+{
+	char file_name[64];
+	if (snprintf(
+		file_name,
+		sizeof(file_name),
+		SHARED_FILE_PREFIX "%s",
+		name
+	) >= (int) sizeof(file_name)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+#ifdef __linux__
+	// memfd_create(2) never touches a filesystem, so prefer it
+	int fd = memfd_create(file_name, 0U);
+	if (fd != -1 || errno != ENOSYS) return fd;
+#endif /* #ifdef __linux__ */
+
+	// an unlinked temporary file lives exactly as long as its last fd
+	const char *tmpdir = getenv("TMPDIR");
+	char path[256];
+	if (snprintf(
+		path,
+		sizeof(path),
+		"%s/%s.XXXXXX",
+		tmpdir ? tmpdir : "/tmp",
+		file_name
+	) >= (int) sizeof(path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	int fd_tmp = mkstemp(path);
+	if (fd_tmp == -1) return -1;
+	unlink(path);
+	return fd_tmp;
+}
+
+static
+int
+shared_env_name (const char *name, char *buf, size_t size)
+{
+	if (snprintf(buf, size, SHARED_ENV_PREFIX "%s", name) >= (int) size) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef SHARED_H
+#define SHARED_H
+
+#include <stddef.h>     // for size_t
+#include <sys/types.h>  // for pid_t
+
+// memory shared by the whole stack: created by the top of the stack before
+// anything is spawned, inherited as a mapping by children that fork, and
+// found again through an inherited fd named in the environment by children
+// that exec - or, read-only, by anyone allowed into /proc/<pid>/fd
+
+// map size zeroed bytes, shared with every process we spawn from now on
+// name tells regions apart in the environment, so must be unique
+// returns the mapping, or NULL with errno set
+void *
+shared_create (const char *name, size_t size);
+
+// map the region an ancestor created as name, before it reached us via exec
+// returns the mapping, storing its size in *size, or NULL with errno set -
+// ENOENT if there is no such region
+void *
+shared_attach (const char *name, size_t *size);
+
+// keep every region from the program we are about to exec(3) - its fd is
+// made close-on-exec and its environment variable unset. Regions already
+// mapped stay mapped
+// returns 0, or -1 with errno set
+int
+shared_unexport (void);
+
+// map the region created as name by pid, or inherited by it, read-only
+// returns the mapping, storing its size in *size, or NULL with errno set -
+// ENOENT if pid holds no such region
+void *
+shared_find (pid_t pid, const char *name, size_t *size);
+
+#endif /* #ifndef SHARED_H */
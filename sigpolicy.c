@@ -0,0 +1,208 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
+#endif /* #ifndef _XOPEN_SOURCE */
+
+#include <signal.h>     // for sigaction(2), sigaddset(3)
+#include <stdio.h>      // for snprintf(3)
+#include <string.h>     // for strchr(3), strcmp(3)
+#include <unistd.h>     // for _exit(2)
+
+#include "sigpolicy.h"
+#include "stats.h"
+
+static const char *
+action_names[] = {
+	[SIGPOLICY_DEFAULT] = "default",
+	[SIGPOLICY_UNWIND] = "unwind",
+	[SIGPOLICY_EXIT] = "exit",
+	[SIGPOLICY_FORWARD] = "forward",
+	[SIGPOLICY_IGNORE] = "ignore",
+};
+
+#define N_ACTIONS (sizeof(action_names) / sizeof(*action_names))
+
+// set is whether -A named the signal, and installed what it does now
+static
+struct policy {
+	int signum;
+	const char *name;
+	int set;
+	enum sigpolicy_action action;
+	volatile sig_atomic_t installed;
+} policies[] = {
+	{ .signum = SIGHUP, .name = "HUP" },
+	{ .signum = SIGINT, .name = "INT" },
+	{ .signum = SIGQUIT, .name = "QUIT" },
+	{ .signum = SIGTERM, .name = "TERM" },
+	{ .signum = SIGCHLD, .name = "CHLD" },
+};
+
+#define N_POLICIES (sizeof(policies) / sizeof(*policies))
+
+static
+int
+forward_all = 0;
+
+static
+void
+on_exit_signal (int signum);
+
+int
+sigpolicy_parse (const char *str)
+{
+	char buf[128];
+	if (snprintf(buf, sizeof(buf), "%s", str) >= (int) sizeof(buf)) return -1;
+
+	char *next = buf;
+	while (next) {
+		char *name = next;
+		if ((next = strchr(name, ','))) *next++ = '\0';
+		char *action_name = strchr(name, '=');
+		if (!action_name) return -1;
+		*action_name++ = '\0';
+
+		struct policy *policy = NULL;
+		for (size_t i = 0; i < N_POLICIES; i++) {
+			if (strcmp(policies[i].name, name) == 0) policy = &policies[i];
+		}
+		size_t action = 0;
+		while (action < N_ACTIONS && strcmp(action_names[action], action_name) != 0) {
+			action++;
+		}
+		if (!policy || action == N_ACTIONS) return -1;
+		if (policy->signum == SIGCHLD && action != SIGPOLICY_DEFAULT) return -1;
+		policy->set = 1;
+		policy->action = (enum sigpolicy_action) action;
+	}
+	return 0;
+}
+
+void
+sigpolicy_forward_all (void)
+{
+	forward_all = 1;
+}
+
+int
+sigpolicy_forwarding (void)
+{
+	if (forward_all) return 1;
+	for (size_t i = 0; i < N_POLICIES; i++) {
+		if (policies[i].action == SIGPOLICY_FORWARD) return 1;
+	}
+	return 0;
+}
+
+int
+sigpolicy_install (void (*on_unwind)(int), int catch_all, int repeated)
+{
+	sigset_t mask;
+	sigemptyset(&mask);
+	for (size_t i = 0; i < N_POLICIES; i++) {
+		if (policies[i].signum != SIGCHLD) sigaddset(&mask, policies[i].signum);
+	}
+
+	for (size_t i = 0; i < N_POLICIES; i++) {
+		struct policy *policy = &policies[i];
+		// SIGCHLD belongs to the storm and the event loop, when they want it
+		if (policy->signum == SIGCHLD) continue;
+
+		enum sigpolicy_action action = policy->action;
+		if (!policy->set) {
+			action = (policy->signum == SIGINT || catch_all)
+				? SIGPOLICY_UNWIND
+				: SIGPOLICY_DEFAULT;
+			// whatever we inherited stands - an ignored SIGHUP under nohup(1)
+			// stays ignored - unless it is a handler of ours, as an init's
+			// child inherits the init's
+			if (action == SIGPOLICY_DEFAULT && policy->installed == SIGPOLICY_DEFAULT) {
+				continue;
+			}
+		}
+		if (action == SIGPOLICY_UNWIND && forward_all) action = SIGPOLICY_FORWARD;
+
+		struct sigaction sa = { .sa_mask = mask, .sa_flags = 0 };
+		switch (action) {
+		case SIGPOLICY_DEFAULT:
+			sa.sa_handler = SIG_DFL;
+			break;
+		case SIGPOLICY_UNWIND:
+		case SIGPOLICY_FORWARD:
+			sa.sa_handler = on_unwind;
+			if (catch_all) break;
+			sa.sa_flags = SA_RESTART;
+			// a broadcast arrives on top of whatever signal we were sent,
+			// as does an init's forwarded copy, so keep the handler
+			// installed for it
+			if (action == SIGPOLICY_UNWIND && !repeated) sa.sa_flags |= SA_RESETHAND;
+			break;
+		case SIGPOLICY_EXIT:
+			sa.sa_handler = on_exit_signal;
+			break;
+		case SIGPOLICY_IGNORE:
+			sa.sa_handler = SIG_IGN;
+			break;
+		}
+		if (sigaction(policy->signum, &sa, NULL) == -1) return -1;
+		policy->installed = (sig_atomic_t) action;
+	}
+	return 0;
+}
+
+int
+sigpolicy_forwards (int signum)
+{
+	for (size_t i = 0; i < N_POLICIES; i++) {
+		if (policies[i].signum == signum) {
+			return policies[i].installed == SIGPOLICY_FORWARD;
+		}
+	}
+	return 0;
+}
+
+void
+sigpolicy_reset (void)
+{
+	struct sigaction sa = { .sa_handler = SIG_DFL, .sa_flags = 0 };
+	sigemptyset(&sa.sa_mask);
+	for (size_t i = 0; i < N_POLICIES; i++) {
+		if (policies[i].installed == SIGPOLICY_IGNORE) {
+			sigaction(policies[i].signum, &sa, NULL);
+		}
+	}
+}
+
+void
+sigpolicy_fill (sigset_t *set)
+{
+	for (size_t i = 0; i < N_POLICIES; i++) {
+		sigaddset(set, policies[i].signum);
+	}
+}
+
+static
+void
+on_exit_signal (int signum)
+{
+	// no unwinding, no re-raising - our children are left to their own
+	// policies
+	stats_signal(signum);
+	_exit(128 + signum);
+}
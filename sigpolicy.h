@@ -0,0 +1,83 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef SIGPOLICY_H
+#define SIGPOLICY_H
+
+#include <signal.h>     // for sigset_t
+
+// the signal policy table: what each signal Docker and init systems actually
+// send does to a process of the stack, installed with sigaction(2) - each
+// handler runs with the rest of the table blocked, so that a SIGTERM on the
+// heels of a SIGINT never nests inside it
+
+// what a signal does, set per signal with -A
+enum sigpolicy_action {
+	SIGPOLICY_DEFAULT,      // leave it at its default disposition
+	SIGPOLICY_UNWIND,       // record it, unwind the stack and re-raise it
+	SIGPOLICY_EXIT,         // _exit(2) at once with 128 + the signal
+	SIGPOLICY_FORWARD,      // unwind, and broadcast it to the process group
+	SIGPOLICY_IGNORE,       // SIG_IGN
+};
+
+// -A: parse a comma-separated list of SIGNAL=action, naming signals without
+// their SIG - HUP, INT, QUIT, TERM or CHLD - and an action from default,
+// unwind, exit, forward or ignore. SIGCHLD only takes default: ignoring it
+// has the kernel reap our children before we can, and a handler for it buys
+// nothing, since every backend waits on its children directly
+// returns 0, or -1 if str is not one
+int
+sigpolicy_parse (const char *str);
+
+// -g: forward every signal we unwind on, rather than only those set to
+void
+sigpolicy_forward_all (void);
+
+// whether any signal is forwarded, and the process group broadcast needs
+// setting up
+int
+sigpolicy_forwarding (void);
+
+// install the table, with on_unwind as the handler for the signals we unwind
+// on. A signal set to nothing takes its default action: SIGINT unwinds, and
+// the rest are left alone - unless catch_all, as an init or wrapping a
+// command must, which unwinds on all of them. Unwinding is one-shot, as
+// signal(3) was - a second SIGINT kills a stuck level - and restarts
+// whatever it interrupts, since the handler only records the signal; catch_all
+// keeps its handlers and interrupts waits instead, so that an init wakes up to
+// forward every signal it is sent. repeated, for an init's children - who get
+// a signal sent to the group twice, once from the group and once from the
+// init - keeps the handlers too, and still restarts
+// returns 0, or -1 with errno set
+int
+sigpolicy_install (void (*on_unwind)(int), int catch_all, int repeated);
+
+// whether the table, as installed, forwards signum
+// async-signal-safe
+int
+sigpolicy_forwards (int signum);
+
+// put every signal the table ignores back to its default, ahead of an exec
+// that should catch nothing on our behalf
+void
+sigpolicy_reset (void);
+
+// add every signal in the table, SIGCHLD included, to set
+void
+sigpolicy_fill (sigset_t *set);
+
+#endif /* #ifndef SIGPOLICY_H */
@@ -0,0 +1,160 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif /* #ifndef _GNU_SOURCE */
+#endif /* #ifdef __linux__ */
+
+// for vfork(2), dropped from POSIX.1-2008
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif /* #ifndef _DEFAULT_SOURCE */
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
+#endif /* #ifndef _XOPEN_SOURCE */
+
+#include <errno.h>      // for errno itself
+#include <signal.h>     // for SIGCHLD
+#include <spawn.h>      // for posix_spawnp(3)
+#include <stdio.h>      // for snprintf(3)
+#include <stdlib.h>     // for calloc(3)
+#include <string.h>     // for strcmp(3)
+#include <unistd.h>     // for _exit(2), execvp(3), fork(2), vfork(2)
+
+#ifdef __linux__
+#include <linux/sched.h>    // for struct clone_args
+#include <sys/syscall.h>    // for SYS_clone3
+#endif /* #ifdef __linux__ */
+
+#include "spawn.h"
+
+extern char **environ;
+
+const char *const
+spawn_engine_names[N_SPAWN_ENGINES] = {
+	[SPAWN_FORK] = "fork",
+	[SPAWN_POSIX_SPAWN] = "posix_spawn",
+	[SPAWN_VFORK] = "vfork",
+	[SPAWN_CLONE3] = "clone3",
+};
+
+static
+enum spawn_engine
+engine = SPAWN_FORK;
+
+// argv for children that exec: our argv[0], "-L" child_level "-R"
+// child_ready_fd, then the rest of ours, built once so there is nothing left to do between vfork(2)
+// and exec
+static
+char **
+child_argv = NULL;
+
+static
+char
+child_level[16], child_ready_fd[16];
+
+static
+pid_t
+clone3_child (void);
+
+int
+spawn_engine_execs (enum spawn_engine which)
+{
+	return which == SPAWN_POSIX_SPAWN || which == SPAWN_VFORK;
+}
+
+int
+spawn_init (enum spawn_engine new_engine, int argc, char **argv)
+{
+	engine = new_engine;
+	if (!spawn_engine_execs(engine)) return 0;
+
+	if ((child_argv = calloc((size_t) argc + 5U, sizeof(*child_argv))) == NULL) {
+		return -1;
+	}
+	// ours go ahead of any "--" and the command after it. Drop the -L and
+	// -R we were started with, so argv doesn't grow with depth - but leave
+	// the command's alone
+	static char level_opt[] = "-L", ready_opt[] = "-R";
+	int child_argc = 0;
+	child_argv[child_argc++] = argv[0];
+	child_argv[child_argc++] = level_opt;
+	child_argv[child_argc++] = child_level;
+	child_argv[child_argc++] = ready_opt;
+	child_argv[child_argc++] = child_ready_fd;
+	int options = 1;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--") == 0) options = 0;
+		int ours = options && (
+			strcmp(argv[i], level_opt) == 0
+			|| strcmp(argv[i], ready_opt) == 0
+		);
+		if (ours && i + 1 < argc) {
+			i++;
+			continue;
+		}
+		child_argv[child_argc++] = argv[i];
+	}
+	return 0;
+}
+
+pid_t
+spawn_child (unsigned child_fork_id, int ready_fd)
+{
+	if (spawn_engine_execs(engine)) {
+		snprintf(child_level, sizeof(child_level), "%u", child_fork_id);
+		snprintf(child_ready_fd, sizeof(child_ready_fd), "%d", ready_fd);
+	}
+
+	pid_t pid;
+	switch (engine) {
+	case SPAWN_POSIX_SPAWN:
+		errno = posix_spawnp(&pid, child_argv[0], NULL, NULL, child_argv, environ);
+		return errno ? -1 : pid;
+	case SPAWN_VFORK:
+		// we share memory with the child until it execs - it may do nothing
+		// but exec or _exit
+		if ((pid = vfork()) == 0) {
+			execvp(child_argv[0], child_argv);
+			_exit(127);
+		}
+		return pid;
+	case SPAWN_CLONE3:
+		return clone3_child();
+	default:
+		return fork();
+	}
+}
+
+static
+pid_t
+clone3_child (void)
+{
+#if defined(__linux__) && defined(SYS_clone3)
+	// no flags - a plain copy of us, reported to us by SIGCHLD, exactly as
+	// fork(2) would make - but glibc's atfork handlers and cached thread
+	// state are skipped, and so must not be relied on in the child
+	struct clone_args args = { .exit_signal = SIGCHLD };
+	return (pid_t) syscall(SYS_clone3, &args, sizeof(args));
+#else
+	errno = ENOSYS;
+	return -1;
+#endif /* #if defined(__linux__) && defined(SYS_clone3) */
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef SPAWN_H
+#define SPAWN_H
+
+#include <sys/types.h>  // for pid_t
+
+// how each level creates its children
+enum spawn_engine {
+	SPAWN_FORK,         // fork(2) - the child carries on from where we are
+	SPAWN_POSIX_SPAWN,  // posix_spawn(3) a fresh copy of ourselves
+	SPAWN_VFORK,        // vfork(2), then exec a fresh copy of ourselves
+	SPAWN_CLONE3,       // a bare clone3(2) - fork(2), minus libc's bookkeeping
+	N_SPAWN_ENGINES
+};
+
+extern const char *const
+spawn_engine_names[N_SPAWN_ENGINES];
+
+// whether children spawned by engine start over from main()
+int
+spawn_engine_execs (enum spawn_engine which);
+
+// use engine for every spawn_child() from now on. Engines that exec start
+// children with "-L level -R ready_fd" ahead of the rest of argv
+// returns 0, or -1 with errno set
+int
+spawn_init (enum spawn_engine engine, int argc, char **argv);
+
+// create a child that starts child_fork_id levels from the bottom, and
+// reports its readiness on ready_fd
+// returns the child's pid, 0 in the child for engines that don't exec, or -1
+// with errno set
+pid_t
+spawn_child (unsigned child_fork_id, int ready_fd);
+
+#endif /* #ifndef SPAWN_H */
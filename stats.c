@@ -0,0 +1,388 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
+#endif /* #ifndef _XOPEN_SOURCE */
+
+#include <errno.h>      // for errno itself
+#include <limits.h>     // for ULLONG_MAX
+#include <signal.h>     // for sigaction(2)
+#include <stdatomic.h>  // for atomic_ullong, atomic_exchange(3)
+#include <string.h>     // for strlen(3)
+#include <unistd.h>     // for getpid(2), write(2)
+
+#include "shared.h"
+#include "stack.h"
+#include "stats.h"
+#include "timing.h"
+
+#if ATOMIC_LLONG_LOCK_FREE != 2
+#error atomic_ullong is not lock-free on this platform
+#endif /* #if ATOMIC_LLONG_LOCK_FREE != 2 */
+
+// signals are counted by number up to this - SIGRTMAX is 64 on Linux
+#define STATS_SIGNALS 65
+
+// a row's dump, on one line - long enough for every signal to have a count
+#define STATS_LINE_MAX 2048U
+
+// one level's counters, summed over every process at it
+struct stats_row {
+	atomic_ullong processes, exited;
+	atomic_ullong waits, eintr, wait_ns;
+	// processes in a wait right now, and the sum of when each started it
+	atomic_ullong waiting, waiting_since_ns;
+	atomic_ullong reraised, fell_back;
+	atomic_ullong signals[STATS_SIGNALS];
+};
+
+// a process in a wait, by pid, so that whoever reaps it can end a wait it
+// never got to - SIGKILLed by a drain or a crash, say
+struct stats_waiter {
+	atomic_ullong pid;          // 0 for never claimed, STATS_GONE once reaped
+	atomic_ullong level;
+	atomic_ullong started_ns;   // 0 outside a wait
+};
+
+#define STATS_GONE ULLONG_MAX
+
+// written once by the top of the stack, ahead of the rows, for exec'd
+// children to find the rest by
+struct stats_header {
+	unsigned long long depth, n_waiters;
+};
+
+static
+struct stats_header *
+stats_header = NULL;
+
+// indexed by fork_id, so row 0 is left unused - lives in memory shared by
+// the whole stack, after the header and before the waiters
+static
+struct stats_row *
+stats_table = NULL;
+
+static
+unsigned
+stats_depth = 0;
+
+// open-addressed by pid, a power of two in size
+static
+struct stats_waiter *
+waiters = NULL;
+
+static
+size_t
+waiters_mask = 0;
+
+// ours, claimed at our first wait - reset after every fork
+static
+struct stats_waiter *
+own_waiter = NULL;
+
+// only the top of the stack sees the whole table through to the terminal
+static volatile
+sig_atomic_t
+stats_root = 0;
+
+static
+struct stats_row *
+own_row (void);
+
+// the waiter for pid: claimed for it, or only found
+static
+struct stats_waiter *
+find_waiter (pid_t pid, int claim);
+
+// take a wait that started at started off row
+static
+void
+end_wait (struct stats_row *row, uint64_t started, int interrupted);
+
+static
+void
+on_dump (int signum);
+
+static
+void
+append_str (char *buf, size_t *len, const char *str);
+
+static
+void
+append_uint (char *buf, size_t *len, unsigned long long val, unsigned width);
+
+int
+stats_init (unsigned depth, unsigned long n_waiting, int top_of_stack)
+{
+	if (top_of_stack) {
+		size_t n_waiters = 1;
+		while (n_waiters < (size_t) n_waiting * 2U) n_waiters <<= 1;
+		stats_header = shared_create(
+			"stats",
+			sizeof(*stats_header)
+				+ (depth + 1) * sizeof(*stats_table)
+				+ n_waiters * sizeof(*waiters)
+		);
+		if (stats_header == NULL) return -1;
+		stats_header->depth = depth;
+		stats_header->n_waiters = n_waiters;
+	}
+	// forked children inherit the mapping as it is
+	else if (stats_header == NULL) {
+		size_t size = 0;
+		if ((stats_header = shared_attach("stats", &size)) == NULL) return -1;
+		if (
+			size < sizeof(*stats_header)
+			|| (size - sizeof(*stats_header)) / sizeof(*stats_table) <= stats_header->depth
+			|| size - sizeof(*stats_header) - (stats_header->depth + 1) * sizeof(*stats_table)
+				< stats_header->n_waiters * sizeof(*waiters)
+		) {
+			errno = EINVAL;
+			return -1;
+		}
+	}
+	stats_depth = (unsigned) stats_header->depth;
+	stats_table = (struct stats_row *) (stats_header + 1);
+	waiters = (struct stats_waiter *) (stats_table + stats_depth + 1);
+	waiters_mask = (size_t) stats_header->n_waiters - 1;
+
+	// restarted, so that a dump leaves every wait as it was - and caught
+	// everywhere, as SIGUSR1 sent to the whole group would otherwise kill it
+	struct sigaction action = { .sa_handler = on_dump, .sa_flags = SA_RESTART };
+	sigemptyset(&action.sa_mask);
+	if (sigaction(SIGUSR1, &action, NULL) == -1) return -1;
+	stats_claim(top_of_stack);
+	return 0;
+}
+
+void
+stats_claim (int top_of_stack)
+{
+	stats_root = top_of_stack;
+	own_waiter = NULL;
+	struct stats_row *row = own_row();
+	if (row) atomic_fetch_add_explicit(&row->processes, 1, memory_order_relaxed);
+}
+
+void
+stats_signal (int signum)
+{
+	struct stats_row *row = own_row();
+	if (row == NULL || signum < 0 || signum >= STATS_SIGNALS) return;
+	atomic_fetch_add_explicit(&row->signals[signum], 1, memory_order_relaxed);
+}
+
+uint64_t
+stats_wait_begin (void)
+{
+	struct stats_row *row = own_row();
+	if (row == NULL) return 0;
+	uint64_t now = timing_now();
+	atomic_fetch_add_explicit(&row->waiting_since_ns, now, memory_order_relaxed);
+	atomic_fetch_add_explicit(&row->waiting, 1, memory_order_relaxed);
+	if (own_waiter == NULL) own_waiter = find_waiter(getpid(), 1);
+	// a full table only costs the reaper the chance to end our wait for us
+	if (own_waiter) atomic_store_explicit(&own_waiter->started_ns, now, memory_order_relaxed);
+	return now;
+}
+
+void
+stats_wait_end (uint64_t started, int interrupted)
+{
+	struct stats_row *row = own_row();
+	if (row == NULL) return;
+	if (own_waiter) atomic_store_explicit(&own_waiter->started_ns, 0, memory_order_relaxed);
+	end_wait(row, started, interrupted);
+}
+
+void
+stats_reaped (pid_t pid)
+{
+	if (waiters == NULL) return;
+	struct stats_waiter *waiter = find_waiter(pid, 0);
+	if (waiter == NULL) return;
+	uint64_t started = atomic_exchange(&waiter->started_ns, 0);
+	unsigned long long level = atomic_load_explicit(&waiter->level, memory_order_relaxed);
+	if (started && level >= 1 && level <= stats_depth) end_wait(&stats_table[level], started, 0);
+	atomic_store_explicit(&waiter->pid, STATS_GONE, memory_order_relaxed);
+}
+
+static
+void
+end_wait (struct stats_row *row, uint64_t started, int interrupted)
+{
+	atomic_fetch_sub_explicit(&row->waiting, 1, memory_order_relaxed);
+	atomic_fetch_sub_explicit(&row->waiting_since_ns, started, memory_order_relaxed);
+	atomic_fetch_add_explicit(&row->waits, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&row->wait_ns, timing_now() - started, memory_order_relaxed);
+	if (interrupted) atomic_fetch_add_explicit(&row->eintr, 1, memory_order_relaxed);
+}
+
+void
+stats_reraised (void)
+{
+	struct stats_row *row = own_row();
+	if (row) atomic_fetch_add_explicit(&row->reraised, 1, memory_order_relaxed);
+}
+
+void
+stats_fell_back (void)
+{
+	struct stats_row *row = own_row();
+	if (row) atomic_fetch_add_explicit(&row->fell_back, 1, memory_order_relaxed);
+}
+
+void
+stats_exit (void)
+{
+	struct stats_row *row = own_row();
+	if (row) atomic_fetch_add_explicit(&row->exited, 1, memory_order_relaxed);
+}
+
+static
+struct stats_row *
+own_row (void)
+{
+	if (stats_table == NULL || fork_id < 1 || fork_id > stats_depth) return NULL;
+	return &stats_table[fork_id];
+}
+
+static
+struct stats_waiter *
+find_waiter (pid_t pid, int claim)
+{
+	if (waiters == NULL) return NULL;
+	unsigned long long key = (unsigned long long) pid;
+	size_t i = ((size_t) pid * 2654435761U) & waiters_mask;
+	for (size_t n = 0; n <= waiters_mask; n++, i = (i + 1) & waiters_mask) {
+		struct stats_waiter *waiter = &waiters[i];
+		unsigned long long held = atomic_load_explicit(&waiter->pid, memory_order_relaxed);
+		if (held == key) return waiter;
+		// a lookup stops at the end of the probe run - a claim takes the
+		// first free entry in it, long since reaped or never used, and no
+		// pid is claimed twice while its process lives
+		if (held == 0 && !claim) return NULL;
+		if (
+			claim
+			&& (held == 0 || held == STATS_GONE)
+			&& atomic_compare_exchange_strong(&waiter->pid, &held, key)
+		) {
+			atomic_store_explicit(&waiter->level, fork_id, memory_order_relaxed);
+			return waiter;
+		}
+	}
+	return NULL;
+}
+
+static
+void
+on_dump (int signum)
+{
+	// only async-signal-safe calls from here - so no stdio, each row
+	// formatted by hand and written with one write(2)
+	int saved_errno = errno;
+	stats_signal(signum);
+	if (!stats_root || stats_table == NULL) {
+		errno = saved_errno;
+		return;
+	}
+
+	char prefix[64];
+	size_t prefix_len = 0;
+	append_str(prefix, &prefix_len, "fork #");
+	append_uint(prefix, &prefix_len, fork_id, 3U);
+	append_str(prefix, &prefix_len, " (pid ");
+	append_uint(prefix, &prefix_len, (unsigned long long) getpid(), 0U);
+	append_str(prefix, &prefix_len, "):\tstats ");
+
+	uint64_t now = timing_now();
+	for (unsigned level = stats_depth; level >= 1; level--) {
+		struct stats_row *row = &stats_table[level];
+		// n waits under way since t1..tn have waited n * now - (t1 + .. + tn)
+		uint64_t waiting = atomic_load(&row->waiting);
+		uint64_t since = atomic_load(&row->waiting_since_ns);
+		uint64_t wait_ns = atomic_load(&row->wait_ns);
+		if (waiting * now > since) wait_ns += waiting * now - since;
+		char line[STATS_LINE_MAX];
+		size_t len = 0;
+		append_str(line, &len, prefix);
+		append_str(line, &len, "level ");
+		append_uint(line, &len, level, 0U);
+		append_str(line, &len, ": processes ");
+		append_uint(line, &len, atomic_load(&row->processes), 0U);
+		append_str(line, &len, " exited ");
+		append_uint(line, &len, atomic_load(&row->exited), 0U);
+		append_str(line, &len, " waiting ");
+		append_uint(line, &len, waiting, 0U);
+		append_str(line, &len, " waits ");
+		append_uint(line, &len, atomic_load(&row->waits), 0U);
+		append_str(line, &len, " eintr ");
+		append_uint(line, &len, atomic_load(&row->eintr), 0U);
+		append_str(line, &len, " wait_us ");
+		append_uint(line, &len, wait_ns / 1000U, 0U);
+		append_str(line, &len, " reraised ");
+		append_uint(line, &len, atomic_load(&row->reraised), 0U);
+		append_str(line, &len, " fell_back ");
+		append_uint(line, &len, atomic_load(&row->fell_back), 0U);
+		append_str(line, &len, " signals");
+		for (int i = 1; i < STATS_SIGNALS; i++) {
+			unsigned long long count = atomic_load(&row->signals[i]);
+			if (count == 0) continue;
+			append_str(line, &len, " ");
+			append_uint(line, &len, (unsigned long long) i, 0U);
+			append_str(line, &len, ":");
+			append_uint(line, &len, count, 0U);
+		}
+		append_str(line, &len, "\n");
+		// best effort - a dump is not worth retrying into a full pipe
+		ssize_t written = write(STDERR_FILENO, line, len);
+		(void) written;
+	}
+	errno = saved_errno;
+}
+
+static
+void
+append_str (char *buf, size_t *len, const char *str)
+{
+	// every buffer here is sized for what goes into it - short of the
+	// signal counts, which stop at the end of the line
+	size_t str_len = strlen(str);
+	if (*len + str_len >= STATS_LINE_MAX - 1U) return;
+	memcpy(buf + *len, str, str_len);
+	*len += str_len;
+}
+
+static
+void
+append_uint (char *buf, size_t *len, unsigned long long val, unsigned width)
+{
+	// right-aligned in width, as printf's %*llu would
+	char digits[24];
+	size_t n = 0;
+	do {
+		digits[n++] = (char) ('0' + val % 10U);
+		val /= 10U;
+	} while (val);
+	char out[32];
+	size_t out_len = 0;
+	while (out_len + n < width && out_len < sizeof(out) - sizeof(digits)) out[out_len++] = ' ';
+	while (n) out[out_len++] = digits[--n];
+	out[out_len] = '\0';
+	append_str(buf, len, out);
+}
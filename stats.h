@@ -0,0 +1,72 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>     // for uint64_t
+#include <sys/types.h>  // for pid_t
+
+// live counters for a running stack: every process adds to its level's row
+// of a table shared by the whole stack - signals caught by number, its
+// blocking waits, the time spent in them and the EINTR retries among them,
+// and how its exit went - with lock-free atomics, cheap enough to leave on.
+// SIGUSR1 to the top of the stack has it write the table out, straight from
+// the signal handler, without disturbing anything else
+
+// -c: create the table for a stack depth levels deep, n_waiting of whose
+// processes wait on children, at the top of the stack, or anywhere else find
+// the one an ancestor created before exec'ing us, and catch SIGUSR1 - only
+// the top of the stack answers it
+// returns 0, or -1 with errno set
+int
+stats_init (unsigned depth, unsigned long n_waiting, int top_of_stack);
+
+// count this process at its level - at startup, and again after every fork,
+// which leaves only the top of the stack answering SIGUSR1
+void
+stats_claim (int top_of_stack);
+
+// count signum caught
+// async-signal-safe
+void
+stats_signal (int signum);
+
+// count a blocking wait for children starting - returns when, to hand to
+// stats_wait_end() - and ending, and whether it was interrupted and retried.
+// A dump counts waits still under way up to the moment it is taken
+uint64_t
+stats_wait_begin (void);
+void
+stats_wait_end (uint64_t started, int interrupted);
+
+// end whatever wait pid, now reaped, was killed in the middle of
+void
+stats_reaped (pid_t pid);
+
+// count that on_exit re-raised the signal that ended us, or that the
+// re-raise did not end us and it fell back to _exit(2)
+void
+stats_reraised (void);
+void
+stats_fell_back (void);
+
+// count that we are exiting
+void
+stats_exit (void);
+
+#endif /* #ifndef STATS_H */
@@ -0,0 +1,145 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
+#endif /* #ifndef _XOPEN_SOURCE */
+
+#include <errno.h>      // for errno itself
+#include <signal.h>     // for sigaction(2)
+#include <stdint.h>     // for uint64_t
+#include <time.h>       // for clock_gettime(3)
+
+#include "log.h"
+#include "storm.h"
+#include "timing.h"
+
+// the signals a storm is made of - neither is fatal to us, and a supervisor
+// sees plenty of both. SIGCHLD is only counted by processes with handlers:
+// the event loop reaps on it, rather than passing it on
+static const int
+storm_signals[] = { SIGUSR2, SIGCHLD };
+
+#define N_STORM_SIGNALS (sizeof(storm_signals) / sizeof(*storm_signals))
+
+static
+int
+storm_enabled = 0;
+
+static
+int
+storm_log_each = 0;
+
+static volatile
+sig_atomic_t
+storm_stopped = 0;
+
+// written from the handlers, read back in normal context by storm_report()
+static volatile
+unsigned long
+counts[N_STORM_SIGNALS];
+
+static volatile
+uint64_t
+handler_ns = 0;
+
+static
+uint64_t
+cpu_now (void);
+
+static
+void
+on_storm (int signum);
+
+int
+storm_init (int handlers, int log_each, sigset_t *events)
+{
+	storm_enabled = 1;
+	storm_log_each = log_each;
+	if (!handlers) {
+		sigaddset(events, SIGUSR2);
+		return 0;
+	}
+
+	// restart whatever a storm interrupts, so it costs the handler and no more
+	struct sigaction action = { .sa_handler = on_storm, .sa_flags = SA_RESTART };
+	sigemptyset(&action.sa_mask);
+	for (size_t i = 0; i < N_STORM_SIGNALS; i++) {
+		if (sigaction(storm_signals[i], &action, NULL) == -1) return -1;
+	}
+	return 0;
+}
+
+int
+storm_is (int signum)
+{
+	if (!storm_enabled) return 0;
+	for (size_t i = 0; i < N_STORM_SIGNALS; i++) {
+		if (storm_signals[i] == signum) return 1;
+	}
+	return 0;
+}
+
+void
+storm_count (int signum)
+{
+	if (storm_stopped) return;
+	uint64_t start = cpu_now();
+	for (size_t i = 0; i < N_STORM_SIGNALS; i++) {
+		if (storm_signals[i] == signum) counts[i]++;
+	}
+	if (storm_log_each) logmsg_async("caught storm signal");
+	handler_ns += cpu_now() - start;
+}
+
+void
+storm_stop (void)
+{
+	storm_stopped = 1;
+}
+
+void
+storm_report (void)
+{
+	if (!storm_enabled) return;
+	logmsg(
+		"storm: caught %lu SIGUSR2, %lu SIGCHLD, %.3f us in handlers",
+		counts[0],
+		counts[1],
+		(double) handler_ns / 1e3
+	);
+	timing_storm(counts[0], counts[1], handler_ns);
+}
+
+static
+uint64_t
+cpu_now (void)
+{
+	// CPU time rather than wall time - a handler preempted still cost nothing
+	struct timespec ts;
+	if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) == -1) return 0;
+	return (uint64_t) ts.tv_sec * UINT64_C(1000000000) + (uint64_t) ts.tv_nsec;
+}
+
+static
+void
+on_storm (int signum)
+{
+	int saved_errno = errno;
+	storm_count(signum);
+	errno = saved_errno;
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef STORM_H
+#define STORM_H
+
+#include <signal.h>     // for sigset_t
+
+// signal-storm accounting: the benchmark harness floods chosen levels of the
+// stack with the storm signals, and each process counts how many times its
+// handler actually ran for each, and the CPU time spent in it - whatever was
+// sent but never counted was coalesced by the kernel, or lost
+
+// -z: count storm signals from now on, through handlers of our own, or -
+// with handlers 0 - leave them blocked for the event loop to read, adding
+// them to events. log_each also queues a log record per signal, exercising
+// the log ring
+// returns 0, or -1 with errno set
+int
+storm_init (int handlers, int log_each, sigset_t *events);
+
+// whether signum is a storm signal we are counting
+// async-signal-safe
+int
+storm_is (int signum);
+
+// count one storm signal - the handler, or the event loop's stand in for it
+// async-signal-safe
+void
+storm_count (int signum);
+
+// stop counting: the storm is over once the fatal signal arrives, and the
+// SIGCHLDs of the unwind are not part of it
+// async-signal-safe
+void
+storm_stop (void);
+
+// log what we counted, and send it with the timing records
+void
+storm_report (void);
+
+#endif /* #ifndef STORM_H */
@@ -0,0 +1,257 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
+#endif /* #ifndef _XOPEN_SOURCE */
+
+#include <errno.h>      // for errno itself
+#include <pthread.h>    // for pthread_create(3), pthread_join(3)
+#include <signal.h>     // for pthread_sigmask(3), sigwait(3)
+#include <stdint.h>     // for uintptr_t
+#include <stdio.h>      // for perror(3)
+#include <stdlib.h>     // for calloc(3), free(3)
+
+#include "log.h"
+#include "ready.h"
+#include "stack.h"
+#include "threads.h"
+#include "timing.h"
+
+// a level needs little more stack than a log line - keep a deep, wide tree
+// from reserving the default 8MiB per thread
+#ifndef THREAD_STACK_SIZE
+#define THREAD_STACK_SIZE (256U * 1024U)
+#endif /* #ifndef THREAD_STACK_SIZE */
+
+// everything below is guarded by lock, and waited on with changed
+static
+pthread_mutex_t
+lock = PTHREAD_MUTEX_INITIALIZER;
+
+static
+pthread_cond_t
+changed = PTHREAD_COND_INITIALIZER;
+
+// leaves awaiting the signal
+static
+unsigned long
+n_ready = 0;
+
+// the signal that stops the stack, once sigwait(3) has taken it
+static
+int
+caught_signum = 0;
+
+// set along with caught_signum - or alone, if a level failed to start its
+// children and the tree will never be whole
+static
+int
+stopping = 0;
+
+// why a level failed, if one did
+static
+int
+failed_errno = 0;
+
+// set once by threads_run(), and read-only after
+static
+unsigned
+top_level = 0, level_fanout = 1U;
+
+static
+unsigned long
+level_leaves = 1UL;
+
+static
+pthread_attr_t
+level_attr;
+
+static
+sigset_t
+handled;
+
+static
+void *
+run_level (void *arg);
+
+static
+void *
+await_signals (void *arg);
+
+static
+void
+level_main (void);
+
+static
+void
+stop (int signum);
+
+static
+void
+fail (const char *what, int err);
+
+int
+threads_run (unsigned depth, unsigned fanout, unsigned long n_leaves)
+{
+	top_level = depth;
+	level_fanout = fanout;
+	level_leaves = n_leaves;
+
+	// every thread inherits the mask, so none but the sigwait(3) thread ever
+	// sees the signal
+	sigemptyset(&handled);
+	sigaddset(&handled, SIGINT);
+	int err = pthread_sigmask(SIG_BLOCK, &handled, NULL);
+	if (err == 0) err = pthread_attr_init(&level_attr);
+	if (err == 0) err = pthread_attr_setstacksize(&level_attr, THREAD_STACK_SIZE);
+	pthread_t sigwait_thread;
+	if (err == 0) err = pthread_create(&sigwait_thread, &level_attr, await_signals, NULL);
+	if (err) {
+		errno = err;
+		return -1;
+	}
+
+	fork_id = depth;
+	level_main();
+	pthread_mutex_lock(&lock);
+	int signum = caught_signum;
+	pthread_mutex_unlock(&lock);
+	// a failed tree leaves the sigwait(3) thread waiting on nothing
+	if (!signum) pthread_cancel(sigwait_thread);
+	pthread_join(sigwait_thread, NULL);
+	pthread_attr_destroy(&level_attr);
+	if (!signum) {
+		errno = failed_errno;
+		return -1;
+	}
+	return signum;
+}
+
+static
+void *
+run_level (void *arg)
+{
+	fork_id = (unsigned) (uintptr_t) arg;
+	logmsg_init();
+	level_main();
+	// the top of the stack does this in on_exit, as a process would
+	timing_mark(TIMING_EXIT);
+	logmsg("exiting");
+	timing_report();
+	return NULL;
+}
+
+static
+void *
+await_signals (void *arg)
+{
+	(void) arg;
+	int signum = 0;
+	// sigwait(3) only fails on an invalid set
+	while (sigwait(&handled, &signum) != 0) continue;
+	stop(signum);
+	return NULL;
+}
+
+static
+void
+level_main (void)
+{
+	pthread_t *children = NULL;
+	unsigned n_spawned = 0;
+
+	logmsg("started");
+	if (fork_id > 1) {
+		if ((children = calloc(level_fanout, sizeof(*children))) == NULL) {
+			fail("level_main: calloc", errno);
+			return;
+		}
+		uint64_t spawn_start = timing_now();
+		for (; n_spawned < level_fanout; n_spawned++) {
+			int err = pthread_create(
+				&children[n_spawned],
+				&level_attr,
+				run_level,
+				(void *) (uintptr_t) (fork_id - 1)
+			);
+			if (err) {
+				fail("level_main: pthread_create", err);
+				break;
+			}
+		}
+		timing_spawned(n_spawned, timing_now() - spawn_start);
+		logmsg("waiting");
+	}
+	else {
+		logmsg("last child awaiting signal");
+		timing_ready();
+		pthread_mutex_lock(&lock);
+		n_ready++;
+		pthread_cond_broadcast(&changed);
+		pthread_mutex_unlock(&lock);
+	}
+
+	pthread_mutex_lock(&lock);
+	if (fork_id == top_level) {
+		while (n_ready < level_leaves && !stopping) {
+			pthread_cond_wait(&changed, &lock);
+		}
+		if (!stopping) {
+			pthread_mutex_unlock(&lock);
+			ready_report();
+			pthread_mutex_lock(&lock);
+		}
+	}
+	// every level wakes on the signal at once, as a process group would
+	while (!stopping) pthread_cond_wait(&changed, &lock);
+	int signum = caught_signum;
+	pthread_mutex_unlock(&lock);
+	if (signum) {
+		timing_mark(TIMING_SIGNAL);
+		logmsg("caught signal");
+	}
+
+	for (unsigned i = 0; i < n_spawned; i++) {
+		pthread_join(children[i], NULL);
+	}
+	if (fork_id > 1) timing_mark(TIMING_REAPED);
+	free(children);
+}
+
+static
+void
+stop (int signum)
+{
+	pthread_mutex_lock(&lock);
+	if (!stopping) caught_signum = signum;
+	stopping = 1;
+	pthread_cond_broadcast(&changed);
+	pthread_mutex_unlock(&lock);
+}
+
+static
+void
+fail (const char *what, int err)
+{
+	errno = err;
+	perror(what);
+	pthread_mutex_lock(&lock);
+	if (!failed_errno) failed_errno = err;
+	pthread_mutex_unlock(&lock);
+	stop(0);
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef THREADS_H
+#define THREADS_H
+
+// the threaded stack, for -p: the same tree with every level a pthread of
+// one process instead of a process of its own, to tell the cost of process
+// management apart from the rest of the teardown
+//
+// every thread blocks SIGINT, and a dedicated thread takes it with
+// sigwait(3), then wakes the whole tree at once. Each level joins its
+// children before it exits - the join chain stands in for reaping - and
+// logs and reports its timing records just as a process would, so that the
+// bench reads both stacks the same way
+
+// run the tree of depth levels on the calling thread, which becomes the top
+// of it, until a signal stops and joins every level beneath
+// returns the signal caught, or -1 with errno set
+int
+threads_run (unsigned depth, unsigned fanout, unsigned long n_leaves);
+
+#endif /* #ifndef THREADS_H */
@@ -0,0 +1,299 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
+#endif /* #ifndef _XOPEN_SOURCE */
+
+#include <errno.h>      // for errno itself
+#include <fcntl.h>      // for fcntl(2)
+#include <stdio.h>      // for snprintf(3)
+#include <time.h>       // for clock_gettime(3)
+#include <unistd.h>     // for getpid(3), write(2)
+
+#include "stack.h"
+#include "timing.h"
+
+// records are single lines of whitespace-separated integers, each written
+// with one write(2) so lines from different processes sharing a pipe never
+// interleave:
+//
+//   B <depth> <leaves> <processes>
+//   R <fork_id> <pid> <ready ns>
+//   S <fork_id> <pid> <children> <ns spent spawning them>
+//   T <ns from the top of the stack starting to the whole tree being up>
+//   X <fork_id> <pid> <signal ns> <reaped ns> <exit ns>
+//   Q <fork_id> <pid> <probes> <unstamped> [<floor ns>:<count>]...
+//   Z <fork_id> <pid> <SIGUSR2s> <SIGCHLDs> <handler CPU ns>
+//   H <fork_id> <pid> <heap kB> <page faults touching it> <ns touching it>
+//   W <fork_id> <pid> <children reaped> <wakeups> <syscalls> <ns from the first to the last>
+//   F <fork_id> <pid> <rss kB> <pss kB> <private dirty kB>
+//   K <fork_id> <pid> <restarts> <ns from a child failing to its respawn being up>
+//
+// a timestamp of 0 means the event never happened
+
+static
+int
+timing_fd = -1;
+
+// written from on_signal, read back in normal context by timing_report()
+// per thread, like fork_id
+static _Thread_local volatile
+uint64_t
+marks[N_TIMING_EVENTS];
+
+static
+void
+timing_write (const char *buf, int len);
+
+uint64_t
+timing_now (void)
+{
+	struct timespec ts;
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1) return 0;
+	return (uint64_t) ts.tv_sec * UINT64_C(1000000000) + (uint64_t) ts.tv_nsec;
+}
+
+void
+timing_init (int fd)
+{
+	timing_fd = fd;
+}
+
+void
+timing_close_on_exec (void)
+{
+	if (timing_fd < 0) return;
+	int flags = fcntl(timing_fd, F_GETFD);
+	if (flags != -1) fcntl(timing_fd, F_SETFD, flags | FD_CLOEXEC);
+}
+
+void
+timing_header (unsigned depth, unsigned long n_leaves, unsigned long n_processes)
+{
+	if (timing_fd < 0) return;
+
+	char buf[128];
+	timing_write(buf, snprintf(
+		buf,
+		sizeof(buf),
+		"B %u %lu %lu\n",
+		depth,
+		n_leaves,
+		n_processes
+	));
+}
+
+void
+timing_ready (void)
+{
+	if (timing_fd < 0) return;
+
+	char buf[128];
+	timing_write(buf, snprintf(
+		buf,
+		sizeof(buf),
+		"R %u %llu %llu\n",
+		fork_id,
+		(long long unsigned) getpid(),
+		(long long unsigned) timing_now()
+	));
+}
+
+void
+timing_stack_ready (uint64_t ready_ns)
+{
+	if (timing_fd < 0) return;
+
+	char buf[64];
+	timing_write(buf, snprintf(
+		buf,
+		sizeof(buf),
+		"T %llu\n",
+		(long long unsigned) ready_ns
+	));
+}
+
+void
+timing_spawned (unsigned n_children, uint64_t spawn_ns)
+{
+	if (timing_fd < 0) return;
+
+	char buf[128];
+	timing_write(buf, snprintf(
+		buf,
+		sizeof(buf),
+		"S %u %llu %u %llu\n",
+		fork_id,
+		(long long unsigned) getpid(),
+		n_children,
+		(long long unsigned) spawn_ns
+	));
+}
+
+void
+timing_respawn (unsigned restarts, uint64_t recover_ns)
+{
+	if (timing_fd < 0) return;
+
+	char buf[128];
+	timing_write(buf, snprintf(
+		buf,
+		sizeof(buf),
+		"K %u %llu %u %llu\n",
+		fork_id,
+		(long long unsigned) getpid(),
+		restarts,
+		(long long unsigned) recover_ns
+	));
+}
+
+void
+timing_heap (unsigned long heap_kb, long faults, uint64_t ns)
+{
+	if (timing_fd < 0) return;
+
+	char buf[128];
+	timing_write(buf, snprintf(
+		buf,
+		sizeof(buf),
+		"H %u %llu %lu %ld %llu\n",
+		fork_id,
+		(long long unsigned) getpid(),
+		heap_kb,
+		faults,
+		(long long unsigned) ns
+	));
+}
+
+void
+timing_reap (
+	unsigned long n_reaped,
+	unsigned long n_wakeups,
+	unsigned long n_syscalls,
+	uint64_t ns
+)
+{
+	if (timing_fd < 0) return;
+
+	char buf[128];
+	timing_write(buf, snprintf(
+		buf,
+		sizeof(buf),
+		"W %u %llu %lu %lu %lu %llu\n",
+		fork_id,
+		(long long unsigned) getpid(),
+		n_reaped,
+		n_wakeups,
+		n_syscalls,
+		(long long unsigned) ns
+	));
+}
+
+void
+timing_footprint (unsigned long rss_kb, unsigned long pss_kb, unsigned long dirty_kb)
+{
+	if (timing_fd < 0) return;
+
+	char buf[128];
+	timing_write(buf, snprintf(
+		buf,
+		sizeof(buf),
+		"F %u %llu %lu %lu %lu\n",
+		fork_id,
+		(long long unsigned) getpid(),
+		rss_kb,
+		pss_kb,
+		dirty_kb
+	));
+}
+
+void
+timing_probes (unsigned long n_probes, unsigned long n_unstamped, const char *buckets)
+{
+	if (timing_fd < 0) return;
+
+	// still well under PIPE_BUF, with every bucket filled
+	char buf[2304];
+	int len = snprintf(
+		buf,
+		sizeof(buf),
+		"Q %u %llu %lu %lu%s\n",
+		fork_id,
+		(long long unsigned) getpid(),
+		n_probes,
+		n_unstamped,
+		buckets
+	);
+	if (len >= (int) sizeof(buf)) return;
+	timing_write(buf, len);
+}
+
+void
+timing_storm (unsigned long n_usr2, unsigned long n_chld, uint64_t handler_ns)
+{
+	if (timing_fd < 0) return;
+
+	char buf[128];
+	timing_write(buf, snprintf(
+		buf,
+		sizeof(buf),
+		"Z %u %llu %lu %lu %llu\n",
+		fork_id,
+		(long long unsigned) getpid(),
+		n_usr2,
+		n_chld,
+		(long long unsigned) handler_ns
+	));
+}
+
+void
+timing_mark (enum timing_event event)
+{
+	if (timing_fd < 0 || marks[event]) return;
+	marks[event] = timing_now();
+}
+
+void
+timing_report (void)
+{
+	if (timing_fd < 0) return;
+
+	char buf[256];
+	timing_write(buf, snprintf(
+		buf,
+		sizeof(buf),
+		"X %u %llu %llu %llu %llu\n",
+		fork_id,
+		(long long unsigned) getpid(),
+		(long long unsigned) marks[TIMING_SIGNAL],
+		(long long unsigned) marks[TIMING_REAPED],
+		(long long unsigned) marks[TIMING_EXIT]
+	));
+}
+
+static
+void
+timing_write (const char *buf, int len)
+{
+	// records are well under PIPE_BUF - a short write means the reader is
+	// gone, and there is nobody left to report to
+	if (len <= 0) return;
+	while (write(timing_fd, buf, (size_t) len) < 0 && errno == EINTR) {
+		continue;
+	}
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdint.h>     // for uint64_t
+
+// moments in a process's life that are timestamped for the benchmark
+// harness
+enum timing_event {
+	TIMING_SIGNAL,  // first fatal signal caught
+	TIMING_REAPED,  // last child reaped
+	TIMING_EXIT,    // on_exit entered
+	N_TIMING_EVENTS
+};
+
+// CLOCK_MONOTONIC in nanoseconds, or 0 if the clock is unavailable
+// async-signal-safe
+uint64_t
+timing_now (void);
+
+// start writing timing records to fd - until this is called, every other
+// timing_* call but timing_now() is a no-op
+void
+timing_init (int fd);
+
+// keep the timing fd from the program we are about to exec(3) - it is
+// ours, not the program's - while still writing records to it until then
+void
+timing_close_on_exec (void);
+
+// announce the shape of the tree, so the reader knows how many ready and
+// exit records to expect
+// called by the top of the stack only
+void
+timing_header (unsigned depth, unsigned long n_leaves, unsigned long n_processes);
+
+// report that this leaf is awaiting a signal
+void
+timing_ready (void);
+
+// report that the whole tree came up ready_ns after the top of the stack
+// started
+void
+timing_stack_ready (uint64_t ready_ns);
+
+// report that spawning our n_children children took spawn_ns
+void
+timing_spawned (unsigned n_children, uint64_t spawn_ns);
+
+// report that a failed child of ours was respawned - our restarts'th - and
+// reported ready recover_ns after the failed one was reaped
+void
+timing_respawn (unsigned restarts, uint64_t recover_ns);
+
+// report that touching our heap_kb kB heap - see heap.h - took faults page
+// faults and ns
+void
+timing_heap (unsigned long heap_kb, long faults, uint64_t ns);
+
+// report that we reaped n_reaped children, in n_wakeups wakeups and
+// n_syscalls system calls, over ns from the first to the last
+void
+timing_reap (
+	unsigned long n_reaped,
+	unsigned long n_wakeups,
+	unsigned long n_syscalls,
+	uint64_t ns
+);
+
+// report our memory footprint - see footprint.h
+void
+timing_footprint (unsigned long rss_kb, unsigned long pss_kb, unsigned long dirty_kb);
+
+// report the realtime-signal probes we caught - buckets as " floor:count"
+// pairs, floors in nanoseconds. See rtsig.h
+void
+timing_probes (unsigned long n_probes, unsigned long n_unstamped, const char *buckets);
+
+// report the storm signals we counted, and the CPU time their handlers took
+// - see storm.h
+void
+timing_storm (unsigned long n_usr2, unsigned long n_chld, uint64_t handler_ns);
+
+// record that event happened now, unless it already has
+// async-signal-safe
+void
+timing_mark (enum timing_event event);
+
+// write this process's timestamps as one record
+void
+timing_report (void);
+
+#endif /* #ifndef TIMING_H */
@@ -0,0 +1,163 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
+#endif /* #ifndef _XOPEN_SOURCE */
+
+#include <errno.h>      // for errno itself
+#include <fcntl.h>      // for open(2)
+#include <string.h>     // for memcpy(3), memcmp(3)
+#include <sys/mman.h>   // for mmap(2)
+#include <sys/stat.h>   // for fstat(2)
+#include <unistd.h>     // for close(2), ftruncate(2), getpid(2)
+
+#include "stack.h"
+#include "timing.h"
+#include "trace.h"
+
+static
+struct trace_header *
+trace = NULL;
+
+static
+struct trace_segment *
+our_segment = NULL;
+
+// cached by trace_claim(), so recording an event needs no getpid(2)
+static
+uint32_t
+our_pid = 0;
+
+static
+void *
+trace_map (int fd, int top_of_stack, size_t *size);
+
+static
+size_t
+segment_size (uint32_t segment_records);
+
+int
+trace_open (const char *path, unsigned long n_segments, unsigned fanout, int top_of_stack)
+{
+	// forked children inherit the mapping as it is
+	if (!top_of_stack && trace) return 0;
+
+	// exec'd children map the file their ancestor made, rather than
+	// truncating it
+	int fd = open(path, top_of_stack ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0644);
+	if (fd == -1) return -1;
+
+	uint32_t segment_records = TRACE_MIN_RECORDS + 2U * fanout;
+	size_t size = sizeof(*trace) + n_segments * segment_size(segment_records);
+	void *mem = trace_map(fd, top_of_stack, &size);
+	int saved_errno = errno;
+	close(fd);
+	if (mem == NULL) {
+		errno = saved_errno;
+		return -1;
+	}
+	trace = mem;
+
+	if (top_of_stack) {
+		memcpy(trace->magic, TRACE_MAGIC, sizeof(trace->magic));
+		trace->version = TRACE_VERSION;
+		trace->record_size = sizeof(struct trace_record);
+		trace->n_segments = (uint32_t) n_segments;
+		trace->segment_records = segment_records;
+	}
+	else if (
+		memcmp(trace->magic, TRACE_MAGIC, sizeof(trace->magic)) != 0
+		|| trace->version != TRACE_VERSION
+	) {
+		munmap(mem, size);
+		trace = NULL;
+		errno = EINVAL;
+		return -1;
+	}
+	return 0;
+}
+
+void
+trace_claim (void)
+{
+	our_segment = NULL;
+	if (trace == NULL) return;
+
+	unsigned segment = atomic_fetch_add_explicit(
+		&trace->next_segment,
+		1U,
+		memory_order_relaxed
+	);
+	// more processes than segments - go untraced, rather than overwrite
+	if (segment >= trace->n_segments) return;
+	our_segment = (struct trace_segment *) (
+		(char *) (trace + 1) + segment * segment_size(trace->segment_records)
+	);
+	our_pid = (uint32_t) getpid();
+	trace_event(TRACE_STARTED, 0, 0);
+}
+
+void
+trace_event (enum trace_event event, int signum, pid_t arg)
+{
+	struct trace_segment *segment = our_segment;
+	if (segment == NULL) return;
+
+	// a handler may interrupt us between reserving and writing - it just
+	// takes the next record
+	unsigned i = atomic_fetch_add_explicit(&segment->n_records, 1U, memory_order_relaxed);
+	if (i >= trace->segment_records) return;
+
+	struct trace_record *rec = (struct trace_record *) (segment + 1) + i;
+	rec->ns = timing_now();
+	rec->pid = our_pid;
+	rec->arg = (uint32_t) arg;
+	rec->level = fork_id;
+	rec->signal = (uint8_t) signum;
+	// last, so a process killed mid-record leaves it unfinished
+	atomic_signal_fence(memory_order_release);
+	rec->event = (uint8_t) event;
+}
+
+static
+void *
+trace_map (int fd, int top_of_stack, size_t *size)
+{
+	// the top of the stack sizes the file, everyone else takes it as it is
+	if (top_of_stack) {
+		if (ftruncate(fd, (off_t) *size) == -1) return NULL;
+	}
+	else {
+		struct stat st;
+		if (fstat(fd, &st) == -1) return NULL;
+		*size = (size_t) st.st_size;
+		if (*size < sizeof(*trace)) {
+			errno = EINVAL;
+			return NULL;
+		}
+	}
+	void *mem = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	return mem == MAP_FAILED ? NULL : mem;
+}
+
+static
+size_t
+segment_size (uint32_t segment_records)
+{
+	return sizeof(struct trace_segment) + segment_records * sizeof(struct trace_record);
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdatomic.h>  // for atomic_uint
+#include <stdint.h>     // for uint8_t, uint32_t, uint64_t
+#include <sys/types.h>  // for pid_t
+
+// the binary trace: fixed-size event records written straight into a file
+// mapped by the whole stack, one segment of it per process, so that tracing
+// costs a few stores per event - and no formatting or syscalls. The
+// signal_process_stack_trace decoder turns it back into text, CSV or Chrome
+// trace JSON
+//
+// the file is a trace_header, then n_segments segments, each a
+// trace_segment followed by segment_records trace_records. Everything is in
+// the byte order of the host that wrote it
+
+#define TRACE_MAGIC "SPSTRACE"
+#define TRACE_VERSION 1U
+
+// records every segment has room for, beyond two per child
+#ifndef TRACE_MIN_RECORDS
+#define TRACE_MIN_RECORDS 32U
+#endif /* #ifndef TRACE_MIN_RECORDS */
+
+// 0 is never written, so a record whose event is 0 was never finished
+enum trace_event {
+	TRACE_NONE,
+	TRACE_STARTED,
+	TRACE_SPAWNED,      // arg is the child's pid
+	TRACE_WAITING,      // on our children
+	TRACE_READY,        // a leaf, awaiting a signal
+	TRACE_SIGNAL,       // caught a fatal signal
+	TRACE_REAPED,       // the last of our children
+	TRACE_EXIT,
+	TRACE_RERAISE,      // about to re-raise signal
+	N_TRACE_EVENTS
+};
+
+struct trace_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t record_size;
+	uint32_t n_segments;
+	uint32_t segment_records;
+	atomic_uint next_segment;
+	uint32_t reserved;
+};
+
+struct trace_segment {
+	// records reserved - more than segment_records means some were dropped
+	atomic_uint n_records;
+	uint32_t reserved;
+};
+
+struct trace_record {
+	uint64_t ns;        // CLOCK_MONOTONIC, as timing_now()
+	uint32_t pid;
+	uint32_t arg;
+	uint32_t level;     // fork_id
+	uint8_t signal;
+	uint8_t event;      // written last
+	uint8_t reserved[2];
+};
+
+// -T: create the trace file at path with n_segments segments at the top of
+// the stack, or anywhere else map the one an ancestor created before
+// exec'ing us
+// returns 0, or -1 with errno set
+int
+trace_open (const char *path, unsigned long n_segments, unsigned fanout, int top_of_stack);
+
+// claim a segment for this process - once at startup, and again right
+// after every fork - recording TRACE_STARTED
+void
+trace_claim (void);
+
+// record event, with signum and arg where it has them
+// async-signal-safe
+void
+trace_event (enum trace_event event, int signum, pid_t arg);
+
+#endif /* #ifndef TRACE_H */
@@ -0,0 +1,309 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// signal_process_stack_trace: decode the binary trace the stack writes with
+// -T into text, CSV or Chrome trace JSON
+//
+// see trace.h for the file format
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
+#endif /* #ifndef _XOPEN_SOURCE */
+
+#include <inttypes.h>   // for PRIu32, PRIu64
+#include <stdint.h>     // for uint32_t, uint64_t
+#include <stdlib.h>     // for malloc(3), qsort(3)
+#include <stdio.h>      // for fopen(3), fread(3), printf(3)
+#include <string.h>     // for memcmp(3), strcmp(3)
+#include <sys/stat.h>   // for fstat(2)
+#include <unistd.h>     // for getopt(3)
+
+#include "trace.h"
+
+enum output_format {
+	FORMAT_TEXT,
+	FORMAT_CSV,
+	FORMAT_CHROME,
+	N_FORMATS
+};
+
+static const char *const
+format_names[N_FORMATS] = {
+	[FORMAT_TEXT] = "text",
+	[FORMAT_CSV] = "csv",
+	[FORMAT_CHROME] = "chrome",
+};
+
+static const char *const
+event_names[N_TRACE_EVENTS] = {
+	[TRACE_NONE] = "none",
+	[TRACE_STARTED] = "started",
+	[TRACE_SPAWNED] = "spawned",
+	[TRACE_WAITING] = "waiting",
+	[TRACE_READY] = "ready",
+	[TRACE_SIGNAL] = "signal",
+	[TRACE_REAPED] = "reaped",
+	[TRACE_EXIT] = "exit",
+	[TRACE_RERAISE] = "reraise",
+};
+
+static
+int
+read_trace (FILE *file, struct trace_header *header, struct trace_record **records, size_t *n_records, unsigned long *n_dropped);
+
+static
+int
+compare_records (const void *a, const void *b);
+
+static
+void
+print_text (const struct trace_record *records, size_t n_records);
+
+static
+void
+print_csv (const struct trace_record *records, size_t n_records);
+
+static
+void
+print_chrome (const struct trace_record *records, size_t n_records);
+
+int
+main (int argc, char **argv)
+{
+	enum output_format format = FORMAT_TEXT;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "f:")) != -1) {
+		switch (opt) {
+		case 'f':
+			for (format = 0; format < N_FORMATS; format++) {
+				if (strcmp(optarg, format_names[format]) == 0) break;
+			}
+			if (format == N_FORMATS) {
+				fprintf(stderr, "%s: invalid format: %s\n", argv[0], optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind != argc - 1) goto usage;
+
+	FILE *file = fopen(argv[optind], "rb");
+	if (file == NULL) {
+		perror("main: fopen");
+		return EXIT_FAILURE;
+	}
+	struct trace_header header;
+	struct trace_record *records = NULL;
+	size_t n_records = 0;
+	unsigned long n_dropped = 0;
+	int ret = read_trace(file, &header, &records, &n_records, &n_dropped);
+	fclose(file);
+	if (ret == -1) {
+		fprintf(stderr, "%s: %s: not a trace this decoder can read\n", argv[0], argv[optind]);
+		return EXIT_FAILURE;
+	}
+
+	// every process's segment is in its own order - merge them into one
+	qsort(records, n_records, sizeof(*records), compare_records);
+	switch (format) {
+	case FORMAT_TEXT:
+		print_text(records, n_records);
+		break;
+	case FORMAT_CSV:
+		print_csv(records, n_records);
+		break;
+	case FORMAT_CHROME:
+		print_chrome(records, n_records);
+		break;
+	case N_FORMATS:
+		break;
+	}
+	if (n_dropped) {
+		fprintf(stderr, "%s: %lu records dropped - segments were full\n", argv[0], n_dropped);
+	}
+	free(records);
+	return EXIT_SUCCESS;
+
+usage:
+	fprintf(stderr, "usage: %s [-f text|csv|chrome] trace_path\n", argv[0]);
+	return EXIT_FAILURE;
+}
+
+static
+int
+read_trace (FILE *file, struct trace_header *header, struct trace_record **records, size_t *n_records, unsigned long *n_dropped)
+{
+	if (fread(header, sizeof(*header), 1, file) != 1) return -1;
+	if (
+		memcmp(header->magic, TRACE_MAGIC, sizeof(header->magic)) != 0
+		|| header->version != TRACE_VERSION
+		|| header->record_size != sizeof(struct trace_record)
+	) {
+		return -1;
+	}
+
+
+	// the header is only as good as the file - never size the buffer past
+	// the segments that it can actually hold
+	struct stat st;
+	if (fstat(fileno(file), &st) == -1 || st.st_size < (off_t) sizeof(*header)) return -1;
+	uint64_t left = (uint64_t) st.st_size - sizeof(*header);
+	uint64_t segment_size = sizeof(struct trace_segment)
+		+ (uint64_t) header->segment_records * sizeof(struct trace_record);
+	if (header->n_segments && segment_size > left) return -1;
+	uint32_t n_segments = header->n_segments;
+	if (n_segments && n_segments > left / segment_size) {
+		// truncated - decode the segments that made it
+		n_segments = (uint32_t) (left / segment_size);
+	}
+	uint64_t capacity = (uint64_t) n_segments * header->segment_records;
+	if (capacity > SIZE_MAX / sizeof(struct trace_record)) return -1;
+
+	struct trace_record *out = malloc(capacity ? (size_t) capacity * sizeof(*out) : 1);
+	if (out == NULL) return -1;
+
+	size_t n = 0;
+	for (uint32_t segment = 0; segment < n_segments; segment++) {
+		struct trace_segment seg;
+		if (fread(&seg, sizeof(seg), 1, file) != 1) break;
+		unsigned reserved = atomic_load(&seg.n_records);
+		if (reserved > header->segment_records) {
+			*n_dropped += reserved - header->segment_records;
+		}
+		for (uint32_t i = 0; i < header->segment_records; i++) {
+			if (fread(&out[n], sizeof(*out), 1, file) != 1) {
+				free(out);
+				return -1;
+			}
+			// never finished - or never reserved at all
+			if (out[n].event != TRACE_NONE && out[n].event < N_TRACE_EVENTS) n++;
+		}
+	}
+	*records = out;
+	*n_records = n;
+	return 0;
+}
+
+static
+int
+compare_records (const void *a, const void *b)
+{
+	const struct trace_record *x = a, *y = b;
+	if (x->ns != y->ns) return x->ns < y->ns ? -1 : 1;
+	return 0;
+}
+
+static
+void
+print_text (const struct trace_record *records, size_t n_records)
+{
+	uint64_t start = n_records ? records[0].ns : 0;
+	for (size_t i = 0; i < n_records; i++) {
+		const struct trace_record *rec = &records[i];
+		printf(
+			"%12.3f us  level %2" PRIu32 "  pid %7" PRIu32 "  %-8s",
+			(double) (rec->ns - start) / 1000.0,
+			rec->level,
+			rec->pid,
+			event_names[rec->event]
+		);
+		if (rec->event == TRACE_SPAWNED) printf("  child %" PRIu32, rec->arg);
+		if (rec->signal) printf("  signal %u", (unsigned) rec->signal);
+		printf("\n");
+	}
+}
+
+static
+void
+print_csv (const struct trace_record *records, size_t n_records)
+{
+	printf("ns,level,pid,event,signal,arg\n");
+	for (size_t i = 0; i < n_records; i++) {
+		const struct trace_record *rec = &records[i];
+		printf(
+			"%" PRIu64 ",%" PRIu32 ",%" PRIu32 ",%s,%u,%" PRIu32 "\n",
+			rec->ns,
+			rec->level,
+			rec->pid,
+			event_names[rec->event],
+			(unsigned) rec->signal,
+			rec->arg
+		);
+	}
+}
+
+static
+void
+print_chrome (const struct trace_record *records, size_t n_records)
+{
+	// each level of the tree is a "process" of its own and each of our
+	// processes a "thread" in it, so the viewer lays the tree out by level
+	uint64_t start = n_records ? records[0].ns : 0;
+	uint32_t max_level = 0;
+	for (size_t i = 0; i < n_records; i++) {
+		if (records[i].level > max_level) max_level = records[i].level;
+	}
+
+	printf("{\"traceEvents\":[\n");
+	const char *sep = "";
+	for (uint32_t level = 1; level <= max_level && n_records; level++) {
+		printf(
+			"%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%" PRIu32
+			",\"args\":{\"name\":\"level %" PRIu32 "\"}}",
+			sep,
+			level,
+			level
+		);
+		sep = ",\n";
+	}
+	for (size_t i = 0; i < n_records; i++) {
+		const struct trace_record *rec = &records[i];
+		// a span from start to exit, and an instant for everything between
+		const char *phase = "i";
+		const char *name = event_names[rec->event];
+		if (rec->event == TRACE_STARTED) {
+			phase = "B";
+			name = "alive";
+		}
+		else if (rec->event == TRACE_EXIT) {
+			phase = "E";
+			name = "alive";
+		}
+		printf(
+			"%s{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":%" PRIu32
+			",\"tid\":%" PRIu32,
+			sep,
+			name,
+			phase,
+			(double) (rec->ns - start) / 1000.0,
+			rec->level,
+			rec->pid
+		);
+		if (phase[0] == 'i') printf(",\"s\":\"t\"");
+		printf(
+			",\"args\":{\"event\":\"%s\",\"signal\":%u,\"arg\":%" PRIu32 "}}",
+			event_names[rec->event],
+			(unsigned) rec->signal,
+			rec->arg
+		);
+		sep = ",\n";
+	}
+	printf("\n]}\n");
+}
@@ -0,0 +1,541 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif /* #ifndef _GNU_SOURCE */
+#endif /* #ifdef __linux__ */
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
+#endif /* #ifndef _XOPEN_SOURCE */
+
+#include <errno.h>      // for errno itself
+#include <signal.h>     // for sigprocmask(2)
+#include <stdatomic.h>  // for atomic_thread_fence
+#include <stdint.h>     // for uint64_t, uintptr_t
+#include <stdio.h>      // for perror(3)
+#include <string.h>     // for memset(3)
+#include <sys/wait.h>   // for P_ALL, WEXITED, WNOHANG, WNOWAIT
+#include <unistd.h>     // for close(2), syscall(2)
+
+#ifdef __linux__
+#include <linux/io_uring.h>     // for struct io_uring_params, struct io_uring_sqe
+#include <linux/time_types.h>   // for struct __kernel_timespec
+#include <sys/mman.h>           // for mmap(2), munmap(2)
+#include <sys/signalfd.h>       // for signalfd(2)
+#include <sys/syscall.h>        // for SYS_io_uring_enter, SYS_io_uring_setup
+#endif /* #ifdef __linux__ */
+
+#include "drain.h"
+#include "log.h"
+#include "reap.h"
+#include "stats.h"
+#include "usage.h"
+#include "uring.h"
+
+#ifdef __linux__
+
+// IORING_OP_WAITID is an enumerator, not a macro, and newer than most
+// headers - its number is fixed by the kernel's ABI all the same
+#define OP_WAITID 50U
+
+// tags for what each completion was for
+enum {
+	TAG_CHILD = 1,
+	TAG_SIGNAL,
+	TAG_TIMER,
+};
+
+// a waitid, a signalfd read and a timer are all a level ever has in flight
+#define RING_ENTRIES 4U
+
+struct ring {
+	int fd;
+	unsigned to_submit;
+	void *sq_map, *cq_map;
+	size_t sq_map_size, cq_map_size;
+	unsigned *sq_head, *sq_tail, *sq_mask, *sq_entries, *sq_array;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+	struct io_uring_cqe *cqes;
+};
+
+// the signals handed to on_sig, set by uring_block_signals()
+static
+sigset_t
+handled;
+
+// where completions write - static, since a cancelled request is only
+// torn down once the ring is
+static
+siginfo_t
+child_info;
+
+static
+struct signalfd_siginfo
+signal_infos[16];
+
+static
+struct __kernel_timespec
+timer_at;
+
+// set up a ring, and check the kernel supports op on it - or, with op 0, take
+// what uring_probe() found for granted
+static
+int
+ring_open (struct ring *ring, unsigned op);
+
+static
+void
+ring_close (struct ring *ring);
+
+// queue sqe for the next io_uring_enter(2)
+static
+void
+ring_push (struct ring *ring, const struct io_uring_sqe *sqe);
+
+// submit everything queued, and sleep until at least one completion
+// returns 0, or -1 with errno set
+static
+int
+ring_enter (struct ring *ring);
+
+// take the oldest completion into *cqe
+// returns 1, or 0 if there is none
+static
+int
+ring_pop (struct ring *ring, struct io_uring_cqe *cqe);
+
+static
+void
+push_signal_read (struct ring *ring, int sig_fd);
+
+// hand every signal a completed read returned to on_sig
+// returns 0, or -1 with errno set
+static
+int
+read_signals (const struct io_uring_cqe *cqe, void (*on_sig)(int));
+
+int
+uring_probe (void)
+{
+	struct ring ring;
+	if (ring_open(&ring, OP_WAITID) == -1) return -1;
+	ring_close(&ring);
+	return 0;
+}
+
+int
+uring_block_signals (const sigset_t *signals)
+{
+	handled = *signals;
+	sigset_t blocked = *signals;
+	sigaddset(&blocked, SIGCHLD);
+	return sigprocmask(SIG_BLOCK, &blocked, NULL);
+}
+
+int
+uring_await_signal (void (*on_sig)(int), const volatile sig_atomic_t *done)
+{
+	// every leaf has a ring of its own, so make it as cheap as can be -
+	// uring_probe() has already seen to waitid, newer than any read
+	struct ring ring;
+	if (ring_open(&ring, 0) == -1) return -1;
+	// blocking, so that the ring waits for it to become readable rather than
+	// completing with EAGAIN
+	int sig_fd = signalfd(-1, &handled, SFD_CLOEXEC);
+	if (sig_fd == -1) {
+		perror("uring_await_signal: signalfd");
+		ring_close(&ring);
+		return -1;
+	}
+
+	int res = 0;
+	while (res == 0 && !*done) {
+		push_signal_read(&ring, sig_fd);
+		if (ring_enter(&ring) == -1) {
+			perror("uring_await_signal: io_uring_enter");
+			res = -1;
+			break;
+		}
+		struct io_uring_cqe cqe;
+		while (res == 0 && ring_pop(&ring, &cqe)) res = read_signals(&cqe, on_sig);
+	}
+	close(sig_fd);
+	ring_close(&ring);
+	return res;
+}
+
+int
+uring_reap (pid_t *children, unsigned n_children, void (*on_sig)(int))
+{
+	struct ring ring;
+	if (ring_open(&ring, OP_WAITID) == -1) return -1;
+	int sig_fd = signalfd(-1, &handled, SFD_CLOEXEC);
+	if (sig_fd == -1) {
+		perror("uring_reap: signalfd");
+		ring_close(&ring);
+		return -1;
+	}
+
+	unsigned remaining = n_children;
+	int waiting = 0, reading = 0, timing = 0;
+	int res = 0;
+	while (remaining > 0 && res == 0) {
+		// re-arm whatever completed last time round - all of it submitted by
+		// the same io_uring_enter(2) that sleeps
+		if (!waiting) {
+			// WNOWAIT, so that the reaping itself accounts for each child
+			struct io_uring_sqe sqe = {
+				.opcode = OP_WAITID,
+				.fd = 0,
+				.len = P_ALL,
+				.file_index = WEXITED | WNOWAIT,
+				.addr2 = (uint64_t) (uintptr_t) &child_info,
+				.user_data = TAG_CHILD,
+			};
+			ring_push(&ring, &sqe);
+			waiting = 1;
+		}
+		if (!reading) {
+			push_signal_read(&ring, sig_fd);
+			reading = 1;
+		}
+		uint64_t due = drain_due();
+		if (due && !timing) {
+			timer_at.tv_sec = (long long) (due / UINT64_C(1000000000));
+			timer_at.tv_nsec = (long long) (due % UINT64_C(1000000000));
+			struct io_uring_sqe sqe = {
+				.opcode = IORING_OP_TIMEOUT,
+				.addr = (uint64_t) (uintptr_t) &timer_at,
+				.len = 1,
+				.timeout_flags = IORING_TIMEOUT_ABS,
+				.user_data = TAG_TIMER,
+			};
+			ring_push(&ring, &sqe);
+			timing = 1;
+		}
+
+		// signals come off the ring, so nothing interrupts the wait
+		uint64_t wait_start = stats_wait_begin();
+		int entered = ring_enter(&ring);
+		stats_wait_end(wait_start, 0);
+		if (entered == -1) {
+			perror("uring_reap: io_uring_enter");
+			res = -1;
+			break;
+		}
+		reap_syscalls(1);
+
+		int exited = 0;
+		struct io_uring_cqe cqe;
+		while (res == 0 && ring_pop(&ring, &cqe)) {
+			switch (cqe.user_data) {
+			case TAG_CHILD:
+				waiting = 0;
+				if (cqe.res < 0) {
+					errno = -cqe.res;
+					perror("uring_reap: waitid");
+					res = -1;
+				}
+				exited = 1;
+				break;
+			case TAG_SIGNAL:
+				reading = 0;
+				res = read_signals(&cqe, on_sig);
+				break;
+			case TAG_TIMER:
+				timing = 0;
+				// the deadline, rather than the ring going away
+				if (cqe.res == -ETIME) {
+					drain_expire();
+					logmsg_drain();
+				}
+				break;
+			}
+		}
+		if (!exited || res == -1) continue;
+		reap_woke();
+
+		// reap everything that has exited by now, as the classic backend does
+		pid_t pid = 0;
+		while (remaining > 0 && (pid = usage_wait(NULL, WNOHANG)) > 0) {
+			reap_syscalls(1);
+			long slot = reap_take(pid);
+			if (slot < 0) continue;
+			children[slot] = 0;
+			remaining--;
+		}
+		if (remaining > 0) reap_syscalls(1);
+		if (remaining > 0 && pid == -1 && errno != ECHILD) {
+			perror("uring_reap: wait4");
+			res = -1;
+		}
+	}
+
+	close(sig_fd);
+	ring_close(&ring);
+	if (res == 0) reap_report();
+	return res;
+}
+
+static
+int
+ring_open (struct ring *ring, unsigned op)
+{
+	memset(ring, 0, sizeof(*ring));
+
+	// completions are only ever wanted by this one thread, when it asks for
+	// them - older kernels take neither flag
+	struct io_uring_params params = {
+		.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN,
+	};
+	long fd = syscall(SYS_io_uring_setup, RING_ENTRIES, &params);
+	if (fd == -1 && errno == EINVAL) {
+		memset(&params, 0, sizeof(params));
+		fd = syscall(SYS_io_uring_setup, RING_ENTRIES, &params);
+	}
+	if (fd == -1) {
+		// disabled by sysctl, or by a container's seccomp profile, is as good
+		// as absent
+		if (errno == EPERM) errno = ENOSYS;
+		return -1;
+	}
+	ring->fd = (int) fd;
+
+	// ask after op before mapping anything
+	union {
+		struct io_uring_probe probe;
+		unsigned char bytes[sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op)];
+	} probe;
+	memset(&probe, 0, sizeof(probe));
+	if (op && (
+		syscall(SYS_io_uring_register, ring->fd, IORING_REGISTER_PROBE, &probe, 256) == -1
+		|| probe.probe.last_op < op
+		|| !(probe.probe.ops[op].flags & IO_URING_OP_SUPPORTED)
+	)) {
+		close(ring->fd);
+		errno = ENOSYS;
+		return -1;
+	}
+
+	ring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	ring->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_map_size > ring->sq_map_size) ring->sq_map_size = ring->cq_map_size;
+		ring->cq_map_size = ring->sq_map_size;
+	}
+	ring->sq_map = mmap(
+		NULL,
+		ring->sq_map_size,
+		PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE,
+		ring->fd,
+		IORING_OFF_SQ_RING
+	);
+	if (ring->sq_map == MAP_FAILED) goto error;
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		ring->cq_map = ring->sq_map;
+	}
+	else {
+		ring->cq_map = mmap(
+			NULL,
+			ring->cq_map_size,
+			PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE,
+			ring->fd,
+			IORING_OFF_CQ_RING
+		);
+		if (ring->cq_map == MAP_FAILED) {
+			munmap(ring->sq_map, ring->sq_map_size);
+			goto error;
+		}
+	}
+	ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(
+		NULL,
+		ring->sqes_size,
+		PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE,
+		ring->fd,
+		IORING_OFF_SQES
+	);
+	if (ring->sqes == MAP_FAILED) {
+		if (ring->cq_map != ring->sq_map) munmap(ring->cq_map, ring->cq_map_size);
+		munmap(ring->sq_map, ring->sq_map_size);
+		goto error;
+	}
+
+	unsigned char *sq = ring->sq_map, *cq = ring->cq_map;
+	ring->sq_head = (unsigned *) (sq + params.sq_off.head);
+	ring->sq_tail = (unsigned *) (sq + params.sq_off.tail);
+	ring->sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+	ring->sq_entries = (unsigned *) (sq + params.sq_off.ring_entries);
+	ring->sq_array = (unsigned *) (sq + params.sq_off.array);
+	ring->cq_head = (unsigned *) (cq + params.cq_off.head);
+	ring->cq_tail = (unsigned *) (cq + params.cq_off.tail);
+	ring->cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+	return 0;
+
+error:
+	perror("ring_open: mmap");
+	close(ring->fd);
+	return -1;
+}
+
+static
+void
+ring_close (struct ring *ring)
+{
+	// closing the ring cancels whatever is still in flight
+	munmap(ring->sqes, ring->sqes_size);
+	if (ring->cq_map != ring->sq_map) munmap(ring->cq_map, ring->cq_map_size);
+	munmap(ring->sq_map, ring->sq_map_size);
+	close(ring->fd);
+}
+
+static
+void
+ring_push (struct ring *ring, const struct io_uring_sqe *sqe)
+{
+	// only we write the tail, and a level never has more in flight than the
+	// ring has entries
+	unsigned tail = *ring->sq_tail;
+	unsigned index = tail & *ring->sq_mask;
+	ring->sqes[index] = *sqe;
+	ring->sq_array[index] = index;
+	// the kernel must see the entry before the tail that covers it
+	atomic_thread_fence(memory_order_release);
+	*(volatile unsigned *) ring->sq_tail = tail + 1;
+	ring->to_submit++;
+}
+
+static
+int
+ring_enter (struct ring *ring)
+{
+	for (;;) {
+		long n = syscall(
+			SYS_io_uring_enter,
+			ring->fd,
+			ring->to_submit,
+			1U,
+			IORING_ENTER_GETEVENTS,
+			NULL,
+			0
+		);
+		if (n >= 0) {
+			ring->to_submit -= (unsigned) n;
+			return 0;
+		}
+		// a stop/continue, or a handler for a signal outside our set - the
+		// entries stay queued for the next go
+		if (errno != EINTR) return -1;
+		logmsg_drain();
+	}
+}
+
+static
+int
+ring_pop (struct ring *ring, struct io_uring_cqe *cqe)
+{
+	unsigned head = *ring->cq_head;
+	unsigned tail = *(volatile unsigned *) ring->cq_tail;
+	// and we must see the entry the kernel wrote before the tail
+	atomic_thread_fence(memory_order_acquire);
+	if (head == tail) return 0;
+	*cqe = ring->cqes[head & *ring->cq_mask];
+	atomic_thread_fence(memory_order_release);
+	*(volatile unsigned *) ring->cq_head = head + 1;
+	return 1;
+}
+
+static
+void
+push_signal_read (struct ring *ring, int sig_fd)
+{
+	struct io_uring_sqe sqe = {
+		.opcode = IORING_OP_READ,
+		.fd = sig_fd,
+		.addr = (uint64_t) (uintptr_t) signal_infos,
+		.len = sizeof(signal_infos),
+		.user_data = TAG_SIGNAL,
+	};
+	ring_push(ring, &sqe);
+}
+
+static
+int
+read_signals (const struct io_uring_cqe *cqe, void (*on_sig)(int))
+{
+	if (cqe->res < 0) {
+		if (cqe->res == -EINTR || cqe->res == -EAGAIN) return 0;
+		errno = -cqe->res;
+		perror("read_signals: read");
+		return -1;
+	}
+	for (size_t i = 0; i < (size_t) cqe->res / sizeof(*signal_infos); i++) {
+		int signum = (int) signal_infos[i].ssi_signo;
+		// the waitid, not SIGCHLD, tells us a child exited
+		if (signum == SIGCHLD) continue;
+		on_sig(signum);
+		logmsg_drain();
+	}
+	return 0;
+}
+
+#else /* #ifdef __linux__ */
+
+int
+uring_probe (void)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+int
+uring_block_signals (const sigset_t *signals)
+{
+	(void) signals;
+	errno = ENOSYS;
+	return -1;
+}
+
+int
+uring_await_signal (void (*on_sig)(int), const volatile sig_atomic_t *done)
+{
+	(void) on_sig;
+	(void) done;
+	errno = ENOSYS;
+	return -1;
+}
+
+int
+uring_reap (pid_t *children, unsigned n_children, void (*on_sig)(int))
+{
+	(void) children;
+	(void) n_children;
+	(void) on_sig;
+	errno = ENOSYS;
+	return -1;
+}
+
+#endif /* #ifdef __linux__ */
@@ -0,0 +1,53 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef URING_H
+#define URING_H
+
+#include <signal.h>     // for sigset_t
+#include <sys/types.h>  // for pid_t
+
+// the io_uring wait backend: signals are blocked and read from a signalfd,
+// as in the event loop, but a level submits that read, a waitid(2) on its
+// children and the drain deadline's timer to one ring, and sleeps on all
+// three in a single io_uring_enter(2) - which also submits whatever it is
+// re-arming - without liburing, through the raw syscalls
+//
+// every function returns 0, or -1 with errno set - ENOSYS off Linux, or
+// where the kernel has no io_uring, or no waitid on one (before Linux 6.7)
+
+// check the kernel has everything the backend needs, before anyone relies
+// on it
+int
+uring_probe (void);
+
+// block signals, and SIGCHLD, so they queue for the ring
+// call before forking, so nothing slips in before a child sets up its ring
+int
+uring_block_signals (const sigset_t *signals);
+
+// pass the blocked signals to on_sig as they arrive, until it sets *done
+int
+uring_await_signal (void (*on_sig)(int), const volatile sig_atomic_t *done);
+
+// reap all n_children children, zeroing each as it is reaped, passing any
+// blocked signals that arrive meanwhile to on_sig, and escalating when the
+// drain deadline passes - see drain_due()
+int
+uring_reap (pid_t *children, unsigned n_children, void (*on_sig)(int));
+
+#endif /* #ifndef URING_H */
@@ -0,0 +1,214 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// for wait4(2)
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif /* #ifndef _DEFAULT_SOURCE */
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
+#endif /* #ifndef _XOPEN_SOURCE */
+
+#include <errno.h>      // for errno itself
+#include <stdatomic.h>  // for atomic_ullong
+#include <stdio.h>      // for fprintf(3), perror(3)
+#include <sys/resource.h> // for getrusage(2)
+#include <sys/wait.h>   // for wait4(2)
+
+#include "shared.h"
+#include "stack.h"
+#include "usage.h"
+
+#if ATOMIC_LLONG_LOCK_FREE != 2
+#error atomic_ullong is not lock-free on this platform
+#endif /* #if ATOMIC_LLONG_LOCK_FREE != 2 */
+
+// one level's costs, summed over every process at it - or the whole tree's
+// processes counts those that added their own usage on exit, killed those
+// that a signal ended - once re-raised, so usually the same ones
+struct usage_row {
+	atomic_ullong processes, killed;
+	atomic_ullong user_us, sys_us;
+	atomic_ullong max_rss_kb;   // the largest of any one process
+	atomic_ullong nvcsw, nivcsw;
+	atomic_ullong minflt, majflt;
+};
+
+// indexed by fork_id, so row 0 is left unused - lives in memory shared by
+// the whole stack
+static
+struct usage_row *
+usage_table = NULL;
+
+static
+unsigned
+usage_depth = 0;
+
+// our reaped children, and through them everything beneath us
+static
+struct usage_row
+usage_children;
+
+static
+void
+row_add (struct usage_row *row, const struct rusage *usage);
+
+static
+void
+row_print (const char *label, struct usage_row *row);
+
+static
+unsigned long long
+tv_us (const struct timeval *tv);
+
+int
+usage_init (unsigned depth, int top_of_stack)
+{
+	if (top_of_stack) {
+		usage_table = shared_create("usage", (depth + 1) * sizeof(*usage_table));
+		if (usage_table == NULL) return -1;
+		usage_depth = depth;
+		return 0;
+	}
+	// forked children inherit the mapping as it is
+	if (usage_table) return 0;
+
+	size_t size = 0;
+	if ((usage_table = shared_attach("usage", &size)) == NULL) return -1;
+	usage_depth = (unsigned) (size / sizeof(*usage_table)) - 1;
+	return 0;
+}
+
+pid_t
+usage_wait (int *status, int options)
+{
+	int wait_status = 0;
+	struct rusage usage;
+	pid_t pid = wait4(-1, &wait_status, options, &usage);
+	if (pid > 0) {
+		usage_reaped(fork_id - 1, WIFSIGNALED(wait_status), &usage);
+		if (status) *status = wait_status;
+	}
+	return pid;
+}
+
+void
+usage_reaped (unsigned level, int killed, const struct rusage *usage)
+{
+	row_add(&usage_children, usage);
+	// the child has already added its own usage to its row, unless killed
+	if (killed && usage_table && level >= 1 && level <= usage_depth) {
+		atomic_fetch_add_explicit(&usage_table[level].killed, 1, memory_order_relaxed);
+	}
+}
+
+void
+usage_exit (void)
+{
+	if (usage_table == NULL) return;
+
+	struct rusage self;
+	if (getrusage(RUSAGE_SELF, &self) == -1) {
+		perror("usage_exit: getrusage");
+		return;
+	}
+	if (fork_id <= usage_depth) row_add(&usage_table[fork_id], &self);
+	// only the top of the stack has the whole depth of the tree beneath it
+	if (fork_id != usage_depth) return;
+
+	// the usage of a child we reaped already includes its reaped children,
+	// but the counts only add up level by level
+	row_add(&usage_children, &self);
+	unsigned long long processes = 0, killed = 0;
+	for (unsigned level = 1; level <= usage_depth; level++) {
+		processes += atomic_load(&usage_table[level].processes);
+		killed += atomic_load(&usage_table[level].killed);
+	}
+	atomic_store(&usage_children.processes, processes);
+	atomic_store(&usage_children.killed, killed);
+	fprintf(
+		stderr,
+		"%-6s %7s %7s %10s %10s %10s %8s %8s %9s %7s\n",
+		"level",
+		"procs",
+		"killed",
+		"user_ms",
+		"sys_ms",
+		"maxrss_kb",
+		"vcsw",
+		"ivcsw",
+		"minflt",
+		"majflt"
+	);
+	for (unsigned level = usage_depth; level >= 1; level--) {
+		char label[16];
+		snprintf(label, sizeof(label), "%u", level);
+		row_print(label, &usage_table[level]);
+	}
+	row_print("total", &usage_children);
+}
+
+static
+void
+row_add (struct usage_row *row, const struct rusage *usage)
+{
+	atomic_fetch_add_explicit(&row->processes, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&row->user_us, tv_us(&usage->ru_utime), memory_order_relaxed);
+	atomic_fetch_add_explicit(&row->sys_us, tv_us(&usage->ru_stime), memory_order_relaxed);
+	atomic_fetch_add_explicit(&row->nvcsw, (unsigned long long) usage->ru_nvcsw, memory_order_relaxed);
+	atomic_fetch_add_explicit(&row->nivcsw, (unsigned long long) usage->ru_nivcsw, memory_order_relaxed);
+	atomic_fetch_add_explicit(&row->minflt, (unsigned long long) usage->ru_minflt, memory_order_relaxed);
+	atomic_fetch_add_explicit(&row->majflt, (unsigned long long) usage->ru_majflt, memory_order_relaxed);
+
+	unsigned long long rss = (unsigned long long) usage->ru_maxrss;
+	unsigned long long max = atomic_load_explicit(&row->max_rss_kb, memory_order_relaxed);
+	while (rss > max && !atomic_compare_exchange_weak_explicit(
+		&row->max_rss_kb,
+		&max,
+		rss,
+		memory_order_relaxed,
+		memory_order_relaxed
+	));
+}
+
+static
+void
+row_print (const char *label, struct usage_row *row)
+{
+	fprintf(
+		stderr,
+		"%-6s %7llu %7llu %10.3f %10.3f %10llu %8llu %8llu %9llu %7llu\n",
+		label,
+		atomic_load(&row->processes),
+		atomic_load(&row->killed),
+		(double) atomic_load(&row->user_us) / 1e3,
+		(double) atomic_load(&row->sys_us) / 1e3,
+		atomic_load(&row->max_rss_kb),
+		atomic_load(&row->nvcsw),
+		atomic_load(&row->nivcsw),
+		atomic_load(&row->minflt),
+		atomic_load(&row->majflt)
+	);
+}
+
+static
+unsigned long long
+tv_us (const struct timeval *tv)
+{
+	return (unsigned long long) tv->tv_sec * 1000000ULL + (unsigned long long) tv->tv_usec;
+}
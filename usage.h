@@ -0,0 +1,51 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef USAGE_H
+#define USAGE_H
+
+#include <sys/resource.h> // for struct rusage
+#include <sys/types.h>  // for pid_t
+
+// per-level resource accounting: every reap collects how the child ended and
+// what it cost, and every process adds its own cost to its level's row of a
+// table shared by the whole stack, which the top of the stack prints at exit.
+// The kernel folds a reaped child's own reaped descendants into the usage
+// we collect, so the totals pass up the stack with the reaping
+
+// -u: create the table for a stack depth levels deep at the top of the stack,
+// or anywhere else find the one an ancestor created before exec'ing us
+// returns 0, or -1 with errno set
+int
+usage_init (unsigned depth, int top_of_stack);
+
+// wait for any child, as waitpid(-1, status, options) would, accounting for
+// it as one level beneath us
+pid_t
+usage_wait (int *status, int options);
+
+// account for a child reaped at level, 0 if its level is unknown - killed if
+// a signal ended it
+void
+usage_reaped (unsigned level, int killed, const struct rusage *usage);
+
+// add our own usage to our level's row - at the top of the stack, then print
+// the table and the totals for the whole tree
+void
+usage_exit (void);
+
+#endif /* #ifndef USAGE_H */
@@ -0,0 +1,118 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
+#endif /* #ifndef _XOPEN_SOURCE */
+
+#include <errno.h>      // for errno itself
+#include <signal.h>     // for sigaction(2), sigaltstack(2)
+#include <stdio.h>      // for snprintf(3)
+#include <sys/mman.h>   // for mlockall(2)
+#include <unistd.h>     // for getpid(2), sysconf(3)
+
+#include "log.h"
+#include "stack.h"
+#include "timing.h"
+#include "warm.h"
+
+// room for on_signal and anything it calls, with plenty to spare
+#ifndef WARM_ALTSTACK_SIZE
+#define WARM_ALTSTACK_SIZE (64U * 1024U)
+#endif /* #ifndef WARM_ALTSTACK_SIZE */
+
+// how much of our own stack to fault in ahead of the handler
+#ifndef WARM_STACK_SIZE
+#define WARM_STACK_SIZE (64U * 1024U)
+#endif /* #ifndef WARM_STACK_SIZE */
+
+// inherited across fork(2), so each child touches its copy
+static
+unsigned char
+alt_stack[WARM_ALTSTACK_SIZE];
+
+static
+void
+prefault_stack (size_t page_size);
+
+static
+void
+warm_paths (void);
+
+int
+warm_apply (void)
+{
+	int ret = 0, saved_errno = 0;
+	size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+
+	// writes rather than reads, so the copy-on-write happens now
+	for (size_t offset = 0; offset < sizeof(alt_stack); offset += page_size) {
+		((volatile unsigned char *) alt_stack)[offset] = 0;
+	}
+	stack_t ss = { .ss_sp = alt_stack, .ss_size = sizeof(alt_stack), .ss_flags = 0 };
+	if (sigaltstack(&ss, NULL) == -1) {
+		ret = -1;
+		saved_errno = errno;
+	}
+	prefault_stack(page_size);
+	warm_paths();
+	warm_handlers();
+
+	// last, so that everything above is resident and stays so
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1 && ret == 0) {
+		ret = -1;
+		saved_errno = errno;
+	}
+	if (ret == 0) logmsg("warmed up and locked in memory");
+	errno = saved_errno;
+	return ret;
+}
+
+void
+warm_handlers (void)
+{
+	// whatever else a handler was installed with stays as it was
+	for (int signum = 1; signum <= SIGRTMAX; signum++) {
+		struct sigaction action;
+		if (sigaction(signum, NULL, &action) == -1) continue;
+		if (action.sa_handler == SIG_DFL || action.sa_handler == SIG_IGN) continue;
+		if (action.sa_flags & SA_ONSTACK) continue;
+		action.sa_flags |= SA_ONSTACK;
+		sigaction(signum, &action, NULL);
+	}
+}
+
+static
+void
+prefault_stack (size_t page_size)
+{
+	volatile unsigned char buf[WARM_STACK_SIZE];
+	for (size_t offset = 0; offset < sizeof(buf); offset += page_size) buf[offset] = 0;
+}
+
+static
+void
+warm_paths (void)
+{
+	// what on_signal and logmsg_drain() reach for: the clock, our pid and
+	// the formatting they leave to libc
+	(void) timing_now();
+	(void) getpid();
+	char buf[256];
+	snprintf(buf, sizeof(buf), "fork #%3u (pid %llu):\t%s\n", fork_id, 0ULL, "");
+	logmsg_drain();
+}
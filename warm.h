@@ -0,0 +1,38 @@
+/*
+ * Copyright 2023 Tony Lechner
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the “Software”), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef WARM_H
+#define WARM_H
+
+// the latency-critical mode: the first signal a process handles should not
+// be the first time it touches the pages the handler runs on. Each process
+// prefaults an alternate signal stack and its own stack, runs the lazy
+// paths the handler takes once ahead of time, moves every handler it has
+// onto the alternate stack and locks all of its memory - mlockall(2) is not
+// inherited across fork(2), so this is done again in every child
+
+// warm this process up, once its handlers are installed
+// returns 0, or -1 with errno set - what could be done is done regardless
+int
+warm_apply (void);
+
+// move every handler installed so far onto the alternate stack - for one
+// installed after warm_apply()
+void
+warm_handlers (void);
+
+#endif /* #ifndef WARM_H */